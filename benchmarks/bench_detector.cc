@@ -0,0 +1,320 @@
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "../src/codegen.hh"
+#include "../src/fsm.hh"
+#include "../src/parser.hh"
+#include "../src/synthetic.hh"
+#include "../src/util.hh"
+
+// every phase runs on each test vector, both as it is and replicated into a larger graph
+constexpr int64_t REPLICAS[] = {1, 64};
+// and on synthetic designs from ~10^3 to ~5 * 10^5 nodes (~125 nodes per instance)
+constexpr int64_t SYNTHETIC_INSTANCES_MIN = 8;
+constexpr int64_t SYNTHETIC_INSTANCES_MAX = 4096;
+// merging and grouping are quadratic in the number of FSMs
+constexpr int64_t SYNTHETIC_QUADRATIC_INSTANCES_MAX = 512;
+
+struct Design {
+    fsm::Graph g;
+    std::unique_ptr<fsm::Parser> p;
+
+    Design(const std::string &filename, uint64_t replicas) {
+        p = std::make_unique<fsm::Parser>(&g);
+        p->parse(filename);
+        replicate(replicas);
+    }
+
+    explicit Design(const fsm::SyntheticOptions &options) { fsm::generate_design(&g, options); }
+
+    // copy the whole design replicas - 1 times. copies of the top-level nodes get a suffix so
+    // that the names stay unique
+    void replicate(uint64_t replicas) {
+        auto num_nodes = g.nodes().size();
+        for (uint64_t r = 1; r < replicas; r++) {
+            std::unordered_map<const fsm::Node *, fsm::Node *> mapping;
+            std::vector<std::pair<const fsm::Node *, fsm::Node *>> copies;
+            for (uint64_t i = 0; i < num_nodes; i++) {
+                auto const *node = g.nodes()[i].get();
+                auto name = node->parent || node->name.empty()
+                                ? node->name
+                                : fmt::format("{0}_{1}", node->name, r);
+                auto *n = g.add_node(g.get_free_id(), name, node->type);
+                n->op = node->op;
+                n->value = node->value;
+                if (node->wide_value) {
+                    n->wide_value = std::make_unique<fsm::Literal>(*node->wide_value);
+                }
+                mapping.emplace(node, n);
+                copies.emplace_back(node, n);
+            }
+            for (auto const &[node, n] : copies) {
+                if (node->parent) n->parent = mapping.at(node->parent);
+                if (node->has_info()) {
+                    auto const &from = node->info();
+                    auto &info = n->mutable_info();
+                    info.wire_type = from.wire_type;
+                    info.port_type = from.port_type;
+                    info.event_type = from.event_type;
+                    info.num_gen_block = from.num_gen_block;
+                    for (auto const *child : from.children) {
+                        info.children.emplace_back(mapping.at(child));
+                    }
+                    for (auto const &[name, member] : from.members) {
+                        info.members.emplace(name, mapping.at(member));
+                    }
+                    if (from.module_def) {
+                        info.module_def = std::make_unique<fsm::ModuleDefInfo>();
+                        info.module_def->name = from.module_def->name;
+                        for (auto const &[name, param] : from.module_def->params) {
+                            info.module_def->params.emplace(name, mapping.at(param));
+                        }
+                    }
+                }
+                for (auto const &edge : node->edges_to) {
+                    n->add_edge(mapping.at(edge->to), edge->type);
+                }
+            }
+        }
+    }
+};
+
+// builds the design for the benchmark argument, i.e. replicas or synthetic instances
+using DesignFactory = std::function<std::unique_ptr<Design>(int64_t)>;
+
+void set_counters(benchmark::State &state, const fsm::Graph &g) {
+    state.counters["nodes"] = static_cast<double>(g.nodes().size());
+    state.counters["nodes_rate"] = benchmark::Counter(
+        static_cast<double>(g.nodes().size()), benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void BM_parse(benchmark::State &state, const std::string &filename) {
+    for (auto _ : state) {
+        fsm::Graph g;
+        fsm::Parser p(&g);
+        p.parse(filename);
+        benchmark::DoNotOptimize(g.nodes().data());
+        state.PauseTiming();
+        set_counters(state, g);
+        state.ResumeTiming();
+    }
+}
+
+void BM_identify_registers(benchmark::State &state, const DesignFactory &make_design) {
+    auto d = make_design(state.range(0));
+    for (auto _ : state) {
+        d->g.identify_registers();
+        auto registers = d->g.get_registers();
+        benchmark::DoNotOptimize(registers.data());
+    }
+    set_counters(state, d->g);
+}
+
+void BM_get_constant_source(benchmark::State &state, const DesignFactory &make_design) {
+    auto d = make_design(state.range(0));
+    d->g.identify_registers();
+    auto registers = d->g.get_registers();
+    for (auto _ : state) {
+        for (auto const *reg : registers) {
+            auto edges = fsm::Graph::get_constant_source(reg);
+            benchmark::DoNotOptimize(edges.size());
+        }
+    }
+    set_counters(state, d->g);
+}
+
+void BM_has_control_loop(benchmark::State &state, const DesignFactory &make_design) {
+    auto d = make_design(state.range(0));
+    d->g.identify_registers();
+    auto registers = d->g.get_registers();
+    for (auto _ : state) {
+        for (auto const *reg : registers) {
+            benchmark::DoNotOptimize(fsm::Graph::has_control_loop(reg));
+        }
+    }
+    set_counters(state, d->g);
+}
+
+void BM_identify_fsms(benchmark::State &state, const DesignFactory &make_design) {
+    auto d = make_design(state.range(0));
+    for (auto _ : state) {
+        auto fsms = d->g.identify_fsms();
+        benchmark::DoNotOptimize(fsms.data());
+    }
+    set_counters(state, d->g);
+}
+
+void BM_extract_fsm_arcs(benchmark::State &state, const DesignFactory &make_design) {
+    auto d = make_design(state.range(0));
+    auto fsms = d->g.identify_fsms();
+    for (auto _ : state) {
+        fsm::identify_fsm_arcs(fsms);
+    }
+    set_counters(state, d->g);
+}
+
+void BM_merge_pipelined_fsm(benchmark::State &state, const DesignFactory &make_design) {
+    auto d = make_design(state.range(0));
+    auto fsms = d->g.identify_fsms();
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto result = fsms;
+        state.ResumeTiming();
+        fsm::merge_pipelined_fsm(result);
+        benchmark::DoNotOptimize(result.data());
+    }
+    set_counters(state, d->g);
+}
+
+void BM_group_fsms(benchmark::State &state, const DesignFactory &make_design) {
+    auto d = make_design(state.range(0));
+    auto fsms = d->g.identify_fsms();
+    for (auto _ : state) {
+        auto groups = fsm::Graph::group_fsms(fsms);
+        benchmark::DoNotOptimize(groups.size());
+    }
+    set_counters(state, d->g);
+}
+
+// data-flow cone of every register, i.e. a traversal that skips control edges. the second
+// argument enables Graph::partition_edges(). edges_touched is how many out-edges the traversal
+// reads, edges_visited how many of them it follows
+void BM_data_cone(benchmark::State &state, const DesignFactory &make_design) {
+    auto d = make_design(state.range(0));
+    if (state.range(1)) d->g.partition_edges();
+    d->g.identify_registers();
+    auto registers = d->g.get_registers();
+    for (auto _ : state) {
+        uint64_t visited = 0;
+        for (auto const *reg : registers) {
+            fsm::breadth_first<fsm::CONTROL_EDGES>(reg, [&visited](const fsm::Edge *) {
+                visited++;
+                return fsm::Step::Follow;
+            });
+        }
+        benchmark::DoNotOptimize(visited);
+    }
+
+    uint64_t touched = 0, visited = 0;
+    for (auto const *reg : registers) {
+        std::unordered_set<const fsm::Node *> seen = {reg};
+        std::vector<const fsm::Node *> queue = {reg};
+        for (uint64_t i = 0; i < queue.size(); i++) {
+            auto const *node = queue[i];
+            touched += node->edges_partitioned() ? node->control_edges_begin
+                                                 : node->edges_to.size();
+            fsm::for_each_edge_to<fsm::CONTROL_EDGES>(node, [&](const fsm::Edge *edge) {
+                visited++;
+                if (seen.emplace(edge->to).second) queue.emplace_back(edge->to);
+                return true;
+            });
+        }
+    }
+    set_counters(state, d->g);
+    state.counters["edges_touched"] = static_cast<double>(touched);
+    state.counters["edges_visited"] = static_cast<double>(visited);
+}
+
+// property generation needs a single top module with clock and reset, so no replicas here
+std::unique_ptr<fsm::VerilogModule> create_module(Design &d) {
+    auto fsms = d.g.identify_fsms();
+    fsm::identify_fsm_arcs(fsms);
+    auto m = std::make_unique<fsm::VerilogModule>(&d.g, d.p->parser_result());
+    m->set_fsm_result(fsms);
+    m->analyze_pins();
+    m->create_properties();
+    return m;
+}
+
+void BM_codegen_str(benchmark::State &state, const std::string &filename) {
+    Design d(filename, 1);
+    auto m = create_module(d);
+    for (auto _ : state) {
+        auto str = m->str();
+        benchmark::DoNotOptimize(str.data());
+    }
+    set_counters(state, d.g);
+}
+
+void register_benchmarks() {
+    using Function = void (*)(benchmark::State &, const DesignFactory &);
+    const std::pair<const char *, Function> benchmarks[] = {
+        {"identify_registers", BM_identify_registers},
+        {"get_constant_source", BM_get_constant_source},
+        {"has_control_loop", BM_has_control_loop},
+        {"identify_fsms", BM_identify_fsms},
+        {"extract_fsm_arcs", BM_extract_fsm_arcs},
+        {"merge_pipelined_fsm", BM_merge_pipelined_fsm},
+        {"group_fsms", BM_group_fsms}};
+
+    std::vector<std::string> filenames;
+    for (auto const &entry : std::filesystem::directory_iterator(PASTAFARIAN_VECTORS_DIR)) {
+        if (entry.path().extension() == ".json") filenames.emplace_back(entry.path().string());
+    }
+    std::sort(filenames.begin(), filenames.end());
+
+    for (auto const &filename : filenames) {
+        auto name = std::filesystem::path(filename).stem().string();
+        benchmark::RegisterBenchmark(("parse/" + name).c_str(), BM_parse, filename);
+        DesignFactory make_design = [filename](int64_t replicas) {
+            return std::make_unique<Design>(filename, replicas);
+        };
+        for (auto const &[phase, function] : benchmarks) {
+            auto *b = benchmark::RegisterBenchmark((std::string(phase) + "/" + name).c_str(),
+                                                   function, make_design);
+            for (auto replicas : REPLICAS) b->Arg(replicas);
+        }
+        auto *b = benchmark::RegisterBenchmark(("data_cone/" + name).c_str(), BM_data_cone,
+                                               make_design);
+        for (auto replicas : REPLICAS) {
+            b->Args({replicas, 0})->Args({replicas, 1});
+        }
+        try {
+            Design d(filename, 1);
+            auto m = create_module(d);
+            benchmark::DoNotOptimize(m->str().data());
+        } catch (const std::runtime_error &) {
+            continue;
+        }
+        benchmark::RegisterBenchmark(("codegen_str/" + name).c_str(), BM_codegen_str, filename);
+    }
+
+    // the argument is the number of module instances
+    DesignFactory make_synthetic = [](int64_t instances) {
+        fsm::SyntheticOptions options;
+        options.num_instances = static_cast<uint32_t>(instances);
+        options.fsms_per_module = 4;
+        options.states_per_fsm = 6;
+        options.counter_ratio = 0.25;
+        options.coupling_density = 0.25;
+        options.noise_registers = 4;
+        return std::make_unique<Design>(options);
+    };
+    for (auto const &[phase, function] : benchmarks) {
+        auto quadratic = function == BM_merge_pipelined_fsm || function == BM_group_fsms;
+        auto max = quadratic ? SYNTHETIC_QUADRATIC_INSTANCES_MAX : SYNTHETIC_INSTANCES_MAX;
+        benchmark::RegisterBenchmark((std::string(phase) + "/synthetic").c_str(), function,
+                                     make_synthetic)
+            ->RangeMultiplier(8)
+            ->Range(SYNTHETIC_INSTANCES_MIN, max)
+            ->Unit(benchmark::kMillisecond);
+    }
+    auto *b = benchmark::RegisterBenchmark("data_cone/synthetic", BM_data_cone, make_synthetic)
+                  ->Unit(benchmark::kMillisecond);
+    for (auto instances = SYNTHETIC_INSTANCES_MIN; instances <= SYNTHETIC_INSTANCES_MAX;
+         instances *= 8) {
+        b->Args({instances, 0})->Args({instances, 1});
+    }
+}
+
+int main(int argc, char **argv) {
+    register_benchmarks();
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
@@ -10,6 +10,7 @@
 
 #include "fsm.hh"
 #include "source.hh"
+#include "stats.hh"
 #include "util.hh"
 
 using fmt::format;
@@ -17,6 +18,7 @@ using fmt::format;
 namespace fsm {
 
 constexpr char INDENTATION[] = "  ";
+constexpr char PROPERTY_NAME_PREFIX[] = "fsm_state_";
 
 Property::Property(uint32_t id, const Node *top, std::string clk_name, const fsm::Node *state_var1,
                    const fsm::Node *state_value1)
@@ -38,64 +40,59 @@ Property::Property(uint32_t id, const Node *top, std::string clk_name, const fsm
       clk_name(std::move(clk_name)) {}
 
 std::string Property::str() const {
+    fmt::memory_buffer buffer;
+    write(buffer);
+    return fmt::to_string(buffer);
+}
+
+void Property::write(fmt::memory_buffer &buffer) const {
     assert_(!clk_name.empty(), "Design does not have a clock");
-    std::stringstream result;
+    auto out = std::back_inserter(buffer);
 
-    result << "property " << property_name() << ";" << std::endl;
+    fmt::format_to(out, "property {0}{1};\n", PROPERTY_NAME_PREFIX, id);
     // clock
-    result << INDENTATION << "@(posedge " << clk_name << ") ";
+    fmt::format_to(out, "{0}@(posedge {1}) ", INDENTATION, clk_name);
     // compute the SVA expressions
     assert_(state_var1 && state_value1, "state cannot be null");
-    {
-        const auto state_var_name = state_var1->handle_name(top);
-        const auto state_value = ::format("{0}", state_value1->value);
-        result << state_var_name << " == " << state_value;
-    }
+    fmt::format_to(out, "{0} == {1}", state_var1->handle_name(top), state_value1->value_str());
     if (state_var2 && state_value2) {
         // we need to figure out if it has second part
-        std::string op;
         if (delay == 0) {
-            op = "|->";
+            fmt::format_to(out, " |-> ");
+        } else if (delay == 1) {
+            fmt::format_to(out, " |=> ");
         } else {
-            op = "|=>";
-            if (delay > 1) {
-                op = ::format("{0} ##{1}", op, delay - 1);
-            }
+            fmt::format_to(out, " |=> ##{0} ", delay - 1);
         }
-        result << " " << op << " ";
-        const auto state_var_name = state_var2->handle_name(top);
-        const auto state_value = ::format("{0}", state_value2->value);
-        result << state_var_name << " == " << state_value;
+        fmt::format_to(out, "{0} == {1}", state_var2->handle_name(top),
+                       state_value2->value_str());
     }
-    result << ";" << std::endl;
-
-    result << "endproperty" << std::endl;
+    fmt::format_to(out, ";\nendproperty\n");
     // cover
-    result << property_label() << " cover property (" << property_name() << ");" << std::endl;
-
-    return result.str();
+    fmt::format_to(out, "{0}{1}: cover property ({2}{1});\n", PROPERTY_LABEL_PREFIX, id,
+                   PROPERTY_NAME_PREFIX);
 }
 
-std::string Property::property_name() const { return ::format("fsm_state_{0}", id); }
+std::string Property::property_name() const {
+    return ::format("{0}{1}", PROPERTY_NAME_PREFIX, id);
+}
 
 std::string Property::property_label() const {
     return ::format("{0}{1}:", PROPERTY_LABEL_PREFIX, id);
 }
 
-VerilogModule::VerilogModule(fsm::Graph *graph, SourceManager parser_result,
-                             const std::string &top_name)
-    : parser_result_(std::move(parser_result)) {
+const Node *find_top_module(const Graph &graph, const std::string &top_name) {
     // we loop into graph to see every module node and their parent is null
     std::unordered_map<std::string, const Node *> modules;
-    auto const &nodes = graph->nodes();
-    for (auto const &node : nodes) {
+    for (auto const &node : graph.nodes()) {
         if (node->type == NodeType::Module) {
+            auto const &module_def = node->info().module_def;
             if (!node->parent || node->name == top_name ||
-                (node->module_def && node->module_def->name == top_name)) {
-                if (node->module_def) {
+                (module_def && module_def->name == top_name)) {
+                if (module_def) {
                     // this only works for the top one instantiated once
-                    if (modules.find(node->module_def->name) == modules.end()) {
-                        modules.emplace(node->module_def->name, node.get());
+                    if (modules.find(module_def->name) == modules.end()) {
+                        modules.emplace(module_def->name, node.get());
                     } else {
                         throw std::runtime_error(
                             top_name +
@@ -112,25 +109,32 @@ VerilogModule::VerilogModule(fsm::Graph *graph, SourceManager parser_result,
         for (auto const &iter : modules) {
             std::cerr << "  - " << iter.first << std::endl;
         }
-        root_module_ = modules.begin()->second;
         std::cerr << "Using " << modules.begin()->first << " as top" << std::endl;
+        return modules.begin()->second;
     } else if (modules.size() > 1) {
         if (modules.find(top_name) == modules.end()) {
             throw std::invalid_argument(top_name + " not found");
         }
-        root_module_ = modules.at(top_name);
+        return modules.at(top_name);
     } else {
         assert_(!modules.empty(), "no top module found");
-        root_module_ = modules.begin()->second;
-        if (root_module_->name != top_name && !top_name.empty()) {
-            std::cerr << "Unable to find " << top_name << ". Use " << root_module_->name
-                      << " instead" << std::endl;
+        auto top = modules.begin()->second;
+        if (top->name != top_name && !top_name.empty()) {
+            std::cerr << "Unable to find " << top_name << ". Use " << top->name << " instead"
+                      << std::endl;
         }
+        return top;
     }
+}
+
+VerilogModule::VerilogModule(fsm::Graph *graph, SourceManager parser_result,
+                             const std::string &top_name)
+    : parser_result_(std::move(parser_result)), root_module_(find_top_module(*graph, top_name)) {
+    auto const &nodes = graph->nodes();
 
     // compute the port signatures
     for (auto const &node : nodes) {
-        if (node->parent == root_module_ && node->port_type != PortType::None) {
+        if (node->parent == root_module_ && node->info().port_type != PortType::None) {
             // the ports we're interested in
             ports.emplace(node->name, node.get());
         }
@@ -154,7 +158,10 @@ void VerilogModule::create_properties() {
 
     for (auto const &fsm_result : fsm_results_) {
         auto t = pool.push([this, &id_count, &fsm_result, &mutex, &count, num_fsm, &bar]() {
+            ScopedTrace trace("create_properties", "fsm", fsm_result.node());
+            ScopedTrace wait("wait", "mutex");
             mutex.lock();
+            wait.stop();
             count++;
             bar.progress(count, num_fsm);
             mutex.unlock();
@@ -186,16 +193,17 @@ void VerilogModule::create_properties() {
                 // state transition
                 // get the absolute correct ones
                 auto state_arcs = fsm.syntax_arc();
-                std::set<std::pair<int64_t, int64_t>> state_arc_values;
+                std::set<std::pair<ConstantValue, ConstantValue>> state_arc_values;
                 for (auto const &[from, to] : state_arcs)
-                    state_arc_values.emplace(std::make_pair(from->value, to->value));
+                    state_arc_values.emplace(std::make_pair(from->value_key(), to->value_key()));
                 for (auto const &state_from : unique_states) {
                     for (auto const &state_to : unique_states) {
                         mutex.lock();
                         auto property = std::make_shared<Property>(
                             id_count++, root_module_, clock_name_, fsm.node(), state_from,
                             fsm.node(), state_to);
-                        auto state_pair = std::make_pair(state_from->value, state_to->value);
+                        auto state_pair =
+                            std::make_pair(state_from->value_key(), state_to->value_key());
                         if (state_arc_values.find(state_pair) != state_arc_values.end())
                             property->should_be_valid = true;
                         property->delay = 1;
@@ -215,6 +223,7 @@ void VerilogModule::create_properties() {
     for (auto &t : tasks) {
         t.get();
     }
+    Stats::instance().count("properties", properties_.size());
 }
 
 void VerilogModule::add_cross_properties(
@@ -225,6 +234,7 @@ void VerilogModule::add_cross_properties(
     for (auto const &fsm : fsm_results_) {
         node_index.emplace(fsm.node(), &fsm);
     }
+    auto num_properties = properties_.size();
     // get the maximum id count
     uint32_t id_count = 0;
     for (auto const &iter : properties_) {
@@ -263,6 +273,7 @@ void VerilogModule::add_cross_properties(
             }
         }
     }
+    Stats::instance().count("cross_properties", properties_.size() - num_properties);
 }
 
 Property &VerilogModule::get_property(uint32_t id) const {
@@ -376,10 +387,11 @@ void VerilogModule::analyze_reset() {
         auto sinks = Graph::find_sinks(reset);
         bool found = false;
         for (auto const node : sinks) {
-            if (node->event_type != EventType::None) {
+            auto event_type = node->info().event_type;
+            if (event_type != EventType::None) {
                 // TODO: need to make sure that it's not inverted
-                reset_type_ = node->event_type == EventType::Posedge ? ResetType::Posedge
-                                                                     : ResetType::Negedge;
+                reset_type_ =
+                    event_type == EventType::Posedge ? ResetType::Posedge : ResetType::Negedge;
                 found = true;
                 break;
             }
@@ -392,58 +404,138 @@ void VerilogModule::analyze_reset() {
     }
 }
 
-std::string VerilogModule::str() const {
-    std::stringstream result;
-
+void VerilogModule::write_header(fmt::memory_buffer &buffer) const {
+    auto out = std::back_inserter(buffer);
     // module header. we create ports using the same name so it's basically a pass through
-    result << "module " << TOP_NAME << "(" << std::endl;
+    fmt::format_to(out, "module {0}(\n", TOP_NAME);
     uint32_t count = 0;
     for (auto const &[port_name, port_node] : ports) {
-        assert_(port_node->port_type != PortType::None, "Port doesn't have a direction");
-        assert_(!port_node->wire_type.empty(), "Port type empty");
-        result << INDENTATION << (port_node->port_type == PortType::Input ? "input" : "output")
-               << " " << port_node->wire_type << " " << port_name;
-        if ((++count) != ports.size()) result << ",";
-        result << std::endl;
+        auto const &info = port_node->info();
+        assert_(info.port_type != PortType::None, "Port doesn't have a direction");
+        assert_(!info.wire_type.empty(), "Port type empty");
+        fmt::format_to(out, "{0}{1} {2} {3}", INDENTATION,
+                       info.port_type == PortType::Input ? "input" : "output", info.wire_type,
+                       port_name);
+        if ((++count) != ports.size()) fmt::format_to(out, ",");
+        fmt::format_to(out, "\n");
     }
 
-    result << ");" << std::endl << std::endl;
+    fmt::format_to(out, ");\n\n");
 
     // dut instantiation
-    assert_(root_module_->module_def != nullptr, "root module doesn't have definition");
-    result << root_module_->module_def->name;
+    auto const &module_def = root_module_->info().module_def;
+    assert_(module_def != nullptr, "root module doesn't have definition");
+    fmt::format_to(out, "{0}", module_def->name);
     // parameters
-    if (!root_module_->module_def->params.empty()) {
-        result << " #(" << std::endl << "    ";
+    if (!module_def->params.empty()) {
+        fmt::format_to(out, " #(\n    ");
         count = 0;
-        auto const &params = root_module_->module_def->params;
+        auto const &params = module_def->params;
         for (auto const &[param_name, param_node] : params) {
             int64_t value = param_values_.find(param_name) != param_values_.end()
                                 ? param_values_.at(param_name)
                                 : param_node->value;
-            result << "." << param_name << "(" << value << ")";
-            if (++count != params.size()) result << "," << std::endl << "    ";
+            fmt::format_to(out, ".{0}({1})", param_name, value);
+            if (++count != params.size()) fmt::format_to(out, ",\n    ");
         }
-        result << ")";
+        fmt::format_to(out, ")");
     }
-    result << " " << name << " (.*);" << std::endl << std::endl;
+    fmt::format_to(out, " {0} (.*);\n\n", name);
+}
+
+// flush the wrapper buffer into the output stream once it grows beyond this size
+constexpr uint64_t WRITE_BUFFER_SIZE = 1u << 20u;
+
+template <typename Iter>
+void VerilogModule::write(std::ostream &stream, Iter begin, Iter end) const {
+    fmt::memory_buffer buffer;
+    auto flush = [&]() {
+        stream.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    };
+
+    write_header(buffer);
 
     // all the properties
-    for (auto const &iter : properties_) {
-        // skip the counter one
-        auto const &prop = iter.second;
-        result << prop->str() << std::endl;
+    for (auto it = begin; it != end; it++) {
+        auto const &prop = it->second;
+        prop->write(buffer);
+        buffer.push_back('\n');
+        if (buffer.size() >= WRITE_BUFFER_SIZE) flush();
     }
 
     // end
-    result << "endmodule" << std::endl;
+    fmt::format_to(std::back_inserter(buffer), "endmodule\n");
+    flush();
+}
+
+std::string VerilogModule::str() const {
+    std::stringstream stream;
+    write(stream);
+    return stream.str();
+}
 
-    return result.str();
+void VerilogModule::write(std::ostream &stream) const {
+    write(stream, properties_.begin(), properties_.end());
 }
 
 void VerilogModule::to_file(const std::string &filename) const {
-    std::ofstream f(filename);
-    f << str();
+    ScopedPhase phase("write_wrapper");
+    std::ofstream stream(filename);
+    write(stream);
+    Stats::instance().count("properties", properties_.size());
+}
+
+std::vector<std::string> VerilogModule::to_files(const std::string &filename,
+                                                 uint32_t num_shards) const {
+    assert_(num_shards > 0, "number of shards has to be positive");
+    ScopedPhase phase("write_wrapper");
+    // compute the shard boundaries. properties are split into contiguous id ranges
+    std::vector<decltype(properties_.begin())> boundaries;
+    boundaries.reserve(num_shards + 1);
+    auto num_properties = properties_.size();
+    auto it = properties_.begin();
+    uint64_t pos = 0;
+    for (uint32_t i = 0; i < num_shards; i++) {
+        auto next_pos = num_properties * i / num_shards;
+        std::advance(it, next_pos - pos);
+        pos = next_pos;
+        boundaries.emplace_back(it);
+    }
+    boundaries.emplace_back(properties_.end());
+
+    // filename.sv -> filename_0.sv, filename_1.sv, ...
+    auto ext = fs::get_ext(filename);
+    auto stem = filename.substr(0, filename.size() - ext.size());
+    std::vector<std::string> filenames;
+    filenames.reserve(num_shards);
+    for (uint32_t i = 0; i < num_shards; i++) {
+        filenames.emplace_back(::format("{0}_{1}{2}", stem, i, ext));
+    }
+
+    auto num_cpus = get_num_cpus();
+    cxxpool::thread_pool pool{num_cpus};
+    std::vector<std::future<void>> tasks;
+    tasks.reserve(num_shards);
+    for (uint32_t i = 0; i < num_shards; i++) {
+        auto t = pool.push([this, i, &boundaries, &filenames]() {
+            ScopedTrace trace("write_wrapper", "shard");
+            std::ofstream stream(filenames[i]);
+            write(stream, boundaries[i], boundaries[i + 1]);
+        });
+        tasks.emplace_back(std::move(t));
+    }
+    for (auto &t : tasks) {
+        t.wait();
+    }
+    for (auto &t : tasks) {
+        t.get();
+    }
+    auto &stats = Stats::instance();
+    stats.count("properties", num_properties);
+    stats.count("shards", num_shards);
+
+    return filenames;
 }
 
 void VerilogModule::set_param_values(const std::unordered_map<std::string, int64_t> &params) {
@@ -526,6 +618,7 @@ void JasperGoldGeneration::run_process() {
     }
     auto command = ::format("{0} -allow_unsupported_OS -no_gui -proj {1} {2}", JASPERGOLD_COMMAND,
                             wd, script_filename);
+    ScopedPhase phase("jaspergold");
     subprocess::call(command);
 }
 
@@ -543,11 +636,14 @@ bool JasperGoldGeneration::has_jaspergold() {
 }
 
 void JasperGoldGeneration::parse_result(const std::string &log_file) {
+    ScopedPhase phase("parse_log");
+    uint64_t num_lines = 0, num_results = 0, num_unreachable = 0;
     // keywords
     auto const keyword = ::format("The cover property \"{0}.{1}", TOP_NAME, PROPERTY_LABEL_PREFIX);
     // parse the log
     std::ifstream file(log_file);
     for (std::string line; std::getline(file, line);) {
+        num_lines++;
         // simple scanning
         auto pos = line.find(keyword);
         if (pos != std::string::npos) {
@@ -563,9 +659,15 @@ void JasperGoldGeneration::parse_result(const std::string &log_file) {
                 }
                 auto &property = module_.get_property(id);
                 property.valid = line.find("unreachable") == std::string::npos;
+                num_results++;
+                if (!property.valid) num_unreachable++;
             }
         }
     }
+    auto &stats = Stats::instance();
+    stats.count("lines", num_lines);
+    stats.count("results", num_results);
+    stats.count("unreachable", num_unreachable);
 }
 
 void JasperGoldGeneration::parse_result() {
@@ -1,6 +1,9 @@
 #ifndef PASTAFARIAN_CODEGEN_HH
 #define PASTAFARIAN_CODEGEN_HH
+#include <fmt/format.h>
+
 #include <map>
+#include <ostream>
 
 #include "graph.hh"
 #include "source.hh"
@@ -33,10 +36,15 @@ public:
              const Node *state_value1, const Node *state_var2, const Node *state_value2);
 
     [[nodiscard]] std::string str() const;
+    void write(fmt::memory_buffer &buffer) const;
     [[nodiscard]] std::string property_name() const;
     [[nodiscard]] std::string property_label() const;
 };
 
+// the module node used as the design top. without top_name, one of the modules that have no
+// parent is used
+const Node *find_top_module(const Graph &graph, const std::string &top_name);
+
 class VerilogModule {
 public:
     std::string name;
@@ -70,7 +78,11 @@ public:
     [[nodiscard]] inline const Node *top() const { return root_module_; }
 
     [[nodiscard]] std::string str() const;
+    void write(std::ostream &stream) const;
     void to_file(const std::string &filename) const;
+    // split the properties into num_shards wrapper modules and write them in parallel.
+    // each shard is a complete wrapper that can be proved on its own
+    std::vector<std::string> to_files(const std::string &filename, uint32_t num_shards) const;
 
     void set_param_values(const std::unordered_map<std::string, int64_t> &params);
 
@@ -86,6 +98,9 @@ private:
     std::unordered_map<std::string, int64_t> param_values_;
 
     void analyze_reset();
+    template <typename Iter>
+    void write(std::ostream &stream, Iter begin, Iter end) const;
+    void write_header(fmt::memory_buffer &buffer) const;
 };
 
 class FormalGeneration {
@@ -6,6 +6,7 @@
 #include <queue>
 #include <utility>
 
+#include "stats.hh"
 #include "util.hh"
 
 namespace fsm {
@@ -58,8 +59,21 @@ auto comp_terminate = [](const Edge *edge) -> bool {
     return false;
 };
 
+// same as Graph::find_connection_cond, but keeps the edges in the order they are found
+template <typename Predicate, typename Terminate>
+std::vector<const Edge *> find_connection_edges(const Node *from, Predicate predicate,
+                                                Terminate terminate) {
+    std::vector<const Edge *> result;
+    breadth_first(from, [&](const Edge *edge) {
+        // every node is only expanded once, so the edges are unique
+        if (predicate(edge)) result.emplace_back(edge);
+        return terminate(edge) ? Step::Skip : Step::Follow;
+    });
+    return result;
+}
+
 std::unordered_set<const Node *> FSMResult::comp_const() const {
-    auto comp_edges = Graph::find_connection_cond(node_, comp_cond, comp_terminate);
+    auto comp_edges = find_connection_edges(node_, comp_cond, comp_terminate);
     std::unordered_set<const Node *> result;
     for (auto const node_edge : comp_edges) {
         auto node_comp = node_edge->to;
@@ -74,10 +88,10 @@ std::unordered_set<const Node *> FSMResult::comp_const() const {
     }
     // make the value unique
     std::unordered_set<const Node *> unique_result;
-    std::unordered_set<int64_t> unique_values;
+    std::unordered_set<ConstantValue, ConstantValueHash> unique_values;
     for (auto const node : result) {
-        if (unique_values.find(node->value) == unique_values.end()) {
-            unique_values.emplace(node->value);
+        if (unique_values.find(node->value_key()) == unique_values.end()) {
+            unique_values.emplace(node->value_key());
             unique_result.emplace(node);
         }
     }
@@ -86,19 +100,92 @@ std::unordered_set<const Node *> FSMResult::comp_const() const {
 
 std::set<std::pair<const Node *, const Node *>> make_unique_result(
     const std::set<std::pair<const Node *, const Node *>> &result) {
-    std::set<std::pair<int64_t, int64_t>> unique_values;
+    std::set<std::pair<ConstantValue, ConstantValue>> unique_values;
     std::set<std::pair<const Node *, const Node *>> unique_result;
     for (auto const &[n1, n2] : result) {
-        if (unique_values.find({n1->value, n2->value}) == unique_values.end()) {
+        auto values = std::make_pair(n1->value_key(), n2->value_key());
+        if (unique_values.find(values) == unique_values.end()) {
             unique_result.emplace(std::make_pair(n1, n2));
-            unique_values.emplace(std::make_pair(n1->value, n2->value));
+            unique_values.emplace(values);
         }
     }
 
     return unique_result;
 }
 
+// control nodes that use the comparison result as their condition
+std::vector<ArcExtractor::Control> comp_control_set(const Node *node_comp) {
+    std::vector<const Node *> node_comp_control_set;
+    if (node_comp->has_type(NodeType::Control)) {
+        node_comp_control_set = {node_comp};
+    } else {
+        assert_(node_comp->edges_to.size() == 1, "condition has 1 fan-out");
+        auto temp_node = node_comp;
+        while (temp_node->edges_to.size() == 1 &&
+               temp_node->edges_to.begin()->get()->is_assign()) {
+            temp_node = temp_node->edges_to.begin()->get()->to;
+        }
+        // whether it is a named variable or not. if it is, it means that a named wire
+        // is used as a condition, typically in Chisel
+        // if not, it means we're using normal net
+        if (temp_node->name.empty()) {
+            node_comp_control_set = {node_comp->edges_to.begin()->get()->to};
+        } else {
+            std::queue<const Node *> working_set;
+            std::unordered_set<const Node *> visited;
+            working_set.emplace(temp_node);
+            while (!working_set.empty()) {
+                auto n = working_set.front();
+                working_set.pop();
+                if (visited.find(n) != visited.end()) {
+                    continue;
+                } else {
+                    visited.emplace(n);
+                }
+                const static std::unordered_set<NetOpType> allowed_ops = {NetOpType::BinaryAnd,
+                                                                          NetOpType::BinaryOr};
+                const static std::unordered_set<NetOpType> disallowed_ops = {
+                    NetOpType::LogicalNot, NetOpType::BitwiseNot};
+                for (auto const &edge : n->edges_to) {
+                    auto nn = edge->to;
+                    if (nn->has_type(NodeType ::Control) &&
+                        disallowed_ops.find(nn->op) == disallowed_ops.end() && nn->parent) {
+                        node_comp_control_set.emplace_back(nn);
+                    } else if (edge->is_assign() && !nn->has_type(NodeType::Control) &&
+                               (!nn->name.empty() ||
+                                allowed_ops.find(nn->op) != allowed_ops.end())) {  // NOLINT
+                        working_set.emplace(nn);
+                    } else if (edge->is_assign() && nn->edges_to.size() == 1 &&
+                               (*nn->edges_to.begin())->is_assign() &&
+                               !nn->has_type(NodeType::Control)) {
+                        working_set.emplace(nn);
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<ArcExtractor::Control> result;
+    result.reserve(node_comp_control_set.size());
+    for (auto const *node : node_comp_control_set) {
+        // find out if it has false path
+        const Node *false_branch = nullptr;
+        for_each_edge_to<ASSIGN_EDGES | SLICE_EDGES>(node, [&](const Edge *edge_to) {
+            if (edge_to->has_type(EdgeType::False)) false_branch = edge_to->to;
+            return false_branch == nullptr;
+        });
+        result.emplace_back(ArcExtractor::Control{node, false_branch});
+    }
+    return result;
+}
+
 void FSMResult::extract_fsm_arcs() {
+    // one state variable isn't worth starting a thread pool for
+    ArcExtractor extractor({this});
+    extract_fsm_arcs(extractor);
+}
+
+void FSMResult::extract_fsm_arcs(const ArcExtractor &extractor) {
     // notice that this is not guaranteed to be complete, but have zero false positive.
 
     std::set<std::pair<const Node *, const Node *>> result;
@@ -107,84 +194,21 @@ void FSMResult::extract_fsm_arcs() {
 
     // find all the comparison nodes that compare the state variable with different
     // constants
-
-    auto comp_edges = Graph::find_connection_cond(node_, comp_cond, comp_terminate);
-    for (auto const node_edge : comp_edges) {
+    for (auto const node_edge : extractor.comp_edges(node_)) {
         auto node_comp = node_edge->to;
-        std::vector<const Node *> node_comp_control_set;
-        if (node_comp->has_type(NodeType::Control)) {
-            node_comp_control_set = {node_comp};
-        } else {
-            assert_(node_comp->edges_to.size() == 1, "condition has 1 fan-out");
-            auto temp_node = node_comp;
-            while (temp_node->edges_to.size() == 1 &&
-                   temp_node->edges_to.begin()->get()->is_assign()) {
-                temp_node = temp_node->edges_to.begin()->get()->to;
-            }
-            // whether it is a named variable or not. if it is, it means that a named wire
-            // is used as a condition, typically in Chisel
-            // if not, it means we're using normal net
-            if (temp_node->name.empty()) {
-                node_comp_control_set = {node_comp->edges_to.begin()->get()->to};
-            } else {
-                std::queue<const Node *> working_set;
-                std::unordered_set<const Node *> visited;
-                working_set.emplace(temp_node);
-                while (!working_set.empty()) {
-                    auto n = working_set.front();
-                    working_set.pop();
-                    if (visited.find(n) != visited.end()) {
-                        continue;
-                    } else {
-                        visited.emplace(n);
-                    }
-                    const static std::unordered_set<NetOpType> allowed_ops = {NetOpType::BinaryAnd,
-                                                                              NetOpType::BinaryOr};
-                    const static std::unordered_set<NetOpType> disallowed_ops = {
-                        NetOpType::LogicalNot, NetOpType::BitwiseNot};
-                    for (auto const &edge : n->edges_to) {
-                        auto nn = edge->to;
-                        if (nn->has_type(NodeType ::Control) &&
-                            disallowed_ops.find(nn->op) == disallowed_ops.end() && nn->parent) {
-                            node_comp_control_set.emplace_back(nn);
-                        } else if (edge->is_assign() && !nn->has_type(NodeType::Control) &&
-                                   (!nn->name.empty() ||
-                                    allowed_ops.find(nn->op) != allowed_ops.end())) {  // NOLINT
-                            working_set.emplace(nn);
-                        } else if (edge->is_assign() && nn->edges_to.size() == 1 &&
-                                   (*nn->edges_to.begin())->is_assign() &&
-                                   !nn->has_type(NodeType::Control)) {
-                            working_set.emplace(nn);
-                        }
-                    }
-                }
-            }
-        }
+        auto const &control_set = extractor.control_set(node_comp);
         // find the assign nodes
         for (auto const &edge : const_src_) {
             auto assign_node = edge->to;
-            for (auto const node_comp_control : node_comp_control_set) {
-                // find out if it has false path
-                Edge *false_edge = nullptr;
-                for (auto const &edge_to : node_comp_control->edges_to) {
-                    if (edge_to->has_type(EdgeType::False)) {
-                        false_edge = edge_to.get();
-                        break;
-                    }
-                }
-                if (assign_node->child_of(node_comp_control)) {
-                    if (false_edge) {
-                        if (assign_node->child_of(false_edge->to)) {
-                            continue;
-                        }
-                    }
-                    // this is one transition arc
-                    auto const_to = edge->from;
-                    Node *const_from = get_const_from_comp(node_comp);
-
-                    assert_(const_from != nullptr, "Unable to find const from");
-                    result.emplace(std::make_pair(const_from, const_to));
-                }
+            for (auto const &control : control_set) {
+                if (!assign_node->child_of(control.node)) continue;
+                if (control.false_branch && assign_node->child_of(control.false_branch)) continue;
+                // this is one transition arc
+                auto const_to = edge->from;
+                Node *const_from = get_const_from_comp(node_comp);
+
+                assert_(const_from != nullptr, "Unable to find const from");
+                result.emplace(std::make_pair(const_from, const_to));
             }
         }
     }
@@ -202,12 +226,12 @@ Node *FSMResult::get_const_from_comp(const Node *node_comp) {
 }
 
 std::vector<const Node *> FSMResult::unique_states() const {
-    std::map<int64_t, const Node *> values;
+    std::map<ConstantValue, const Node *> values;
     std::vector<const Node *> result;
 
     for (auto const &edge : const_src_) {
         auto n = edge->from;
-        auto v = n->value;
+        auto v = n->value_key();
         if (values.find(v) == values.end()) {
             values.emplace(v, n);
         }
@@ -228,11 +252,11 @@ std::unordered_set<const Node *> FSMResult::counter_values() const {
     auto values_comp = comp_const();
 
     std::unordered_set<const Node *> result;
-    std::unordered_set<int64_t> values;
+    std::unordered_set<ConstantValue, ConstantValueHash> values;
 
     for (auto const node : values_comp) {
-        if (values.find(node->value) == values.end()) {
-            values.emplace(node->value);
+        if (values.find(node->value_key()) == values.end()) {
+            values.emplace(node->value_key());
             result.emplace(node);
         }
     }
@@ -241,7 +265,7 @@ std::unordered_set<const Node *> FSMResult::counter_values() const {
         auto to = edge->to;
         if (!to->has_type(NodeType::Assign)) continue;
         auto n = edge->from;
-        auto v = n->value;
+        auto v = n->value_key();
         if (values.find(v) == values.end()) {
             values.emplace(v);
             result.emplace(n);
@@ -258,15 +282,17 @@ void FSMResult::merge_fsm(FSMResult &fsm) {
     syntax_arc_.insert(fsm.syntax_arc_.begin(), fsm.syntax_arc_.end());
 }
 
-void identify_fsm_arcs(std::vector<FSMResult> &fsm_result) {
-    auto num_cpus = get_num_cpus();
-    cxxpool::thread_pool pool{num_cpus};
+// runs task(0), ..., task(size - 1) on the pool, or in order on the calling thread
+template <typename Task>
+void run_tasks(cxxpool::thread_pool *pool, uint64_t size, const Task &task) {
+    if (!pool) {
+        for (uint64_t i = 0; i < size; i++) task(i);
+        return;
+    }
     std::vector<std::future<void>> tasks;
-    tasks.reserve(fsm_result.size());
-
-    for (auto &fsm : fsm_result) {
-        auto t = pool.push([&]() -> void { fsm.extract_fsm_arcs(); });
-        tasks.emplace_back(std::move(t));
+    tasks.reserve(size);
+    for (uint64_t i = 0; i < size; i++) {
+        tasks.emplace_back(pool->push([i, &task]() -> void { task(i); }));
     }
     for (auto &t : tasks) {
         t.wait();
@@ -276,7 +302,86 @@ void identify_fsm_arcs(std::vector<FSMResult> &fsm_result) {
     }
 }
 
-bool is_pipelined(const Node *from, const Node *to) {
+ArcExtractor::ArcExtractor(const std::vector<const FSMResult *> &fsms,
+                           cxxpool::thread_pool *pool) {
+    std::vector<const Node *> states;
+    for (auto const *fsm : fsms) {
+        if (fsm->is_counter()) continue;
+        if (comp_edges_.emplace(fsm->node(), std::vector<const Edge *>{}).second) {
+            states.emplace_back(fsm->node());
+        }
+    }
+
+    // comparison nodes of each state variable
+    std::vector<std::vector<const Edge *>> comp_edges(states.size());
+    run_tasks(pool, states.size(), [&states, &comp_edges](uint64_t i) {
+        ScopedTrace trace("comp_edges", "fsm", states[i]);
+        comp_edges[i] = find_connection_edges(states[i], comp_cond, comp_terminate);
+    });
+
+    // each comparison node is only resolved once, even if it's shared by FSMs
+    std::vector<const Node *> comp_nodes;
+    for (uint64_t i = 0; i < states.size(); i++) {
+        for (auto const *edge : comp_edges[i]) {
+            if (control_sets_.emplace(edge->to, std::vector<Control>{}).second) {
+                comp_nodes.emplace_back(edge->to);
+            }
+        }
+        comp_edges_.at(states[i]) = std::move(comp_edges[i]);
+    }
+    std::vector<std::vector<Control>> control_sets(comp_nodes.size());
+    run_tasks(pool, comp_nodes.size(), [&comp_nodes, &control_sets](uint64_t i) {
+        ScopedTrace trace("control_set", "comparison", comp_nodes[i]);
+        control_sets[i] = comp_control_set(comp_nodes[i]);
+    });
+    for (uint64_t i = 0; i < comp_nodes.size(); i++) {
+        control_sets_.at(comp_nodes[i]) = std::move(control_sets[i]);
+    }
+}
+
+const std::vector<const Edge *> &ArcExtractor::comp_edges(const Node *state) const {
+    return comp_edges_.at(state);
+}
+
+const std::vector<ArcExtractor::Control> &ArcExtractor::control_set(const Node *node_comp) const {
+    return control_sets_.at(node_comp);
+}
+
+void identify_fsm_arcs(std::vector<FSMResult> &fsm_result) {
+    std::vector<const FSMResult *> fsms;
+    fsms.reserve(fsm_result.size());
+    for (auto const &fsm : fsm_result) fsms.emplace_back(&fsm);
+
+    auto num_cpus = get_num_cpus();
+    cxxpool::thread_pool pool{num_cpus};
+    ArcExtractor extractor(fsms, &pool);
+
+    run_tasks(&pool, fsm_result.size(), [&fsm_result, &extractor](uint64_t i) {
+        auto &fsm = fsm_result[i];
+        ScopedTrace trace("extract_fsm_arcs", "fsm", fsm.node());
+        fsm.extract_fsm_arcs(extractor);
+    });
+
+    auto &stats = Stats::instance();
+    if (stats.enabled()) {
+        uint64_t num_arcs = 0;
+        for (auto const &fsm : fsm_result) num_arcs += fsm.syntax_arc().size();
+        stats.count("arcs", num_arcs);
+    }
+}
+
+bool is_pipelined(const RouteEngine::Path &path) {
+    // there has to be at least one node in between, and the state variable has to be assigned
+    // through a non-blocking edge
+    return path.size() > 1 && path.back()->has_type(EdgeType::NonBlocking);
+}
+
+void merge_pipelined_fsm(std::vector<FSMResult> &fsm_result) {
+    // this one only merges directly pipelined fsm
+    std::vector<uint64_t> candidates;
+    for (uint64_t i = 0; i < fsm_result.size(); i++) {
+        if (!fsm_result[i].is_counter()) candidates.emplace_back(i);
+    }
     auto predicate = [](const Edge *edge) -> bool {
         if (edge->has_type(EdgeType::Control)) return false;
         // only for fan out one
@@ -284,88 +389,70 @@ bool is_pipelined(const Node *from, const Node *to) {
     };
     // usually the assignment chain won't be more than 16 nodes
     // otherwise whoever create this design is really stupid...
-    auto path = Graph::route(from, to, predicate, 16);
-    if (path.empty()) return false;
-    // need to check if there is an non-blocking edge
-    for (uint64_t i = 0; i < path.size() - 1; i++) {
-        auto node_from = path[i];
-        auto node_to = path[i + 1];
-        // need to check the edge
-        const Edge *edge = nullptr;
-        for (auto &e : node_from->edges_to) {
-            if (e->to == node_to) {
-                edge = e.get();
-                break;
-            }
-        }
-        if (edge->has_type(EdgeType::NonBlocking) && edge->to == to) {
-            return true;
+    // the bound counts edges, i.e. 17 edges leave 16 nodes in between
+    constexpr uint32_t max_length = 17;
+
+    // most pairs aren't connected at all. find the ones that are with a bit-parallel search over
+    // 64 FSMs at a time, and only compute the paths for those
+    std::vector<const Node *> nodes;
+    nodes.reserve(candidates.size());
+    for (auto i : candidates) nodes.emplace_back(fsm_result[i].node());
+    ReachabilityEngine reachability(predicate, max_length);
+    auto connected = reachability.reachable(nodes, nodes);
+
+    std::vector<RouteEngine::Query> queries;
+    std::vector<std::pair<uint64_t, uint64_t>> pairs;
+    for (uint64_t i = 0; i < candidates.size(); i++) {
+        for (uint64_t j = 0; j < candidates.size(); j++) {
+            if (i == j || !connected[i][j]) continue;
+            queries.emplace_back(nodes[i], nodes[j]);
+            pairs.emplace_back(candidates[i], candidates[j]);
         }
     }
-    return false;
-}
 
-void merge_pipelined_fsm(std::vector<FSMResult> &fsm_result) {
-    // this one only merges directly pipelined fsm
-    std::unordered_map<FSMResult *, FSMResult *> pipelined_fsm;
-    for (auto &fsm_from : fsm_result) {
-        for (auto &fsm_to : fsm_result) {
-            if (&fsm_from != &fsm_to && !fsm_from.is_counter() && !fsm_to.is_counter()) {
-                auto from_node = fsm_from.node();
-                auto to_node = fsm_to.node();
-                if (is_pipelined(from_node, to_node)) {
-                    pipelined_fsm.emplace(std::make_pair(&fsm_from, &fsm_to));
-                }
-            }
+    RouteEngine engine(predicate, max_length);
+    // one search per FSM instead of one per pair
+    auto paths = engine.route(queries);
+    Stats::instance().count("route_queries", queries.size());
+
+    DisjointSet sets(fsm_result.size());
+    std::vector<bool> has_upstream(fsm_result.size(), false);
+    bool merged = false;
+    for (uint64_t i = 0; i < paths.size(); i++) {
+        if (is_pipelined(paths[i])) {
+            auto [from, to] = pairs[i];
+            merged |= sets.merge(from, to);
+            has_upstream[to] = true;
         }
     }
     // early out the computation
-    if (pipelined_fsm.empty()) return;
-    // need to find root FSM
-    // union find
-    struct Root {
-        FSMResult *result;
-    };
-    std::unordered_map<FSMResult *, std::shared_ptr<Root>> fsm_root;
-    std::unordered_map<std::shared_ptr<Root>, std::unordered_set<FSMResult *>> fsms;
-    for (auto &[fsm_from, fsm_to] : pipelined_fsm) {
-        if (fsm_root.find(fsm_from) != fsm_root.end()) {
-            // need to merge everything
-            auto root = fsm_root.at(fsm_from);
-            fsms.at(root).emplace(fsm_to);
-            fsm_root.emplace(fsm_to, root);
-        } else if (fsm_root.find(fsm_to) != fsm_root.end()) {
-            // upgrade the root
-            auto root = fsm_root.at(fsm_to);
-            root->result = fsm_from;
-            fsms.at(root).emplace(fsm_from);
-        } else {
-            // new stuff
-            auto root = std::make_shared<Root>();
-            root->result = fsm_from;
-            fsm_root.emplace(fsm_from, root);
-            fsm_root.emplace(fsm_to, root);
-            fsms.emplace(root, std::unordered_set<FSMResult *>{fsm_from, fsm_to});
-        }
+    if (!merged) return;
+
+    // the FSM at the head of the pipeline is kept. if there is none, e.g. the pipeline loops
+    // back, the first one is kept
+    std::vector<uint64_t> head(fsm_result.size(), fsm_result.size());
+    for (uint64_t i = 0; i < fsm_result.size(); i++) {
+        auto &h = head[sets.find(i)];
+        if (h == fsm_result.size() || (has_upstream[h] && !has_upstream[i])) h = i;
     }
 
-    // now we need to merge them
-    for (auto [root, children] : fsms) {
-        auto root_fsm = root->result;
-        for (auto child : children) {
-            if (child != root_fsm) root_fsm->merge_fsm(*child);
-        }
+    std::vector<bool> removed(fsm_result.size(), false);
+    for (uint64_t i = 0; i < fsm_result.size(); i++) {
+        auto h = head[sets.find(i)];
+        if (h == i) continue;
+        fsm_result[h].merge_fsm(fsm_result[i]);
+        removed[i] = true;
     }
-    // delete the fsm that's been merged
-    for (auto const &[root, set] : fsms) {
-        for (auto child : set) {
-            if (child != root->result) {
-                auto pos = std::find(fsm_result.begin(), fsm_result.end(), *child);
-                assert_(pos != fsm_result.end(), "cannot find fsm when merging");
-                fsm_result.erase(pos);
-            }
-        }
+
+    // delete the fsm that's been merged while keeping the order
+    uint64_t size = 0;
+    for (uint64_t i = 0; i < fsm_result.size(); i++) {
+        if (removed[i]) continue;
+        if (size != i) fsm_result[size] = std::move(fsm_result[i]);
+        size++;
     }
+    Stats::instance().count("fsms_merged", fsm_result.size() - size);
+    fsm_result.erase(fsm_result.begin() + static_cast<int64_t>(size), fsm_result.end());
 }
 
 }  // namespace fsm
\ No newline at end of file
@@ -5,8 +5,14 @@
 
 #include "graph.hh"
 
+namespace cxxpool {
+class thread_pool;
+}
+
 namespace fsm {
 
+class ArcExtractor;
+
 class FSMResult {
 public:
     FSMResult(const Node *node, std::unordered_set<const Edge *> const_src);
@@ -23,6 +29,7 @@ public:
         return syntax_arc_;
     }
     void extract_fsm_arcs();
+    void extract_fsm_arcs(const ArcExtractor &extractor);
 
     [[nodiscard]] std::vector<const Node *> unique_states() const;
 
@@ -46,6 +53,30 @@ private:
     std::set<std::pair<const Node *, const Node *>> syntax_arc_;
 };
 
+// state shared by the arc extraction of many FSMs. comparison nodes are discovered once for all
+// FSMs. ancestor tests rely on Graph::label_hierarchy() to be O(1)
+class ArcExtractor {
+public:
+    // without a pool everything is computed on the calling thread
+    explicit ArcExtractor(const std::vector<const FSMResult *> &fsms,
+                          cxxpool::thread_pool *pool = nullptr);
+
+    struct Control {
+        const Node *node;
+        // negated branch of the control node, if any
+        const Node *false_branch;
+    };
+
+    // edges into the nodes that compare the state variable with a constant
+    [[nodiscard]] const std::vector<const Edge *> &comp_edges(const Node *state) const;
+    // control nodes that a comparison node ends up in
+    [[nodiscard]] const std::vector<Control> &control_set(const Node *node_comp) const;
+
+private:
+    std::unordered_map<const Node *, std::vector<const Edge *>> comp_edges_;
+    std::unordered_map<const Node *, std::vector<Control>> control_sets_;
+};
+
 void identify_fsm_arcs(std::vector<FSMResult> &fsm_result);
 void merge_pipelined_fsm(std::vector<FSMResult> &fsm_result);
 
@@ -4,16 +4,67 @@
 #include <tqdm.h>
 
 #include <algorithm>
-#include <cmath>
+#include <limits>
 #include <mutex>
 #include <queue>
 #include <stack>
 
 #include "fsm.hh"
+#include "stats.hh"
 #include "util.hh"
 
 namespace fsm {
 
+std::string to_string(NodeType type) {
+    constexpr std::pair<NodeType, const char *> names[] = {
+        {NodeType::Constant, "Constant"}, {NodeType::Register, "Register"},
+        {NodeType::Net, "Net"},           {NodeType::Variable, "Variable"},
+        {NodeType::Control, "Control"},   {NodeType::Module, "Module"},
+        {NodeType::Assign, "Assign"}};
+    std::vector<std::string_view> flags;
+    for (auto const &[flag, name] : names) {
+        if (static_cast<bool>(type & flag)) flags.emplace_back(name);
+    }
+    return string::join(flags.begin(), flags.end(), "|");
+}
+
+std::string to_string(EdgeType type) {
+    // True and False include the Control bit
+    switch (type) {
+        case EdgeType::True:
+            return "True";
+        case EdgeType::False:
+            return "False";
+        default:
+            break;
+    }
+    constexpr std::pair<EdgeType, const char *> names[] = {{EdgeType::Blocking, "Blocking"},
+                                                           {EdgeType::NonBlocking, "NonBlocking"},
+                                                           {EdgeType::Slice, "Slice"},
+                                                           {EdgeType::Control, "Control"}};
+    std::vector<std::string_view> flags;
+    for (auto const &[flag, name] : names) {
+        if ((type & flag) == flag) flags.emplace_back(name);
+    }
+    return string::join(flags.begin(), flags.end(), "|");
+}
+
+bool ConstantValue::operator==(const ConstantValue &other) const {
+    if (wide_value && other.wide_value) return *wide_value == *other.wide_value;
+    return !wide_value && !other.wide_value && value == other.value;
+}
+
+bool ConstantValue::operator<(const ConstantValue &other) const {
+    // narrow values always come first
+    if (wide_value && other.wide_value) return *wide_value < *other.wide_value;
+    if (wide_value || other.wide_value) return other.wide_value != nullptr;
+    return value < other.value;
+}
+
+std::size_t ConstantValueHash::operator()(const ConstantValue &v) const {
+    return v.wide_value ? v.wide_value->hash() : std::hash<int64_t>()(v.value);
+}
+
 std::string Node::handle_name() const { return handle_name(nullptr); }
 
 std::string Node::handle_name(const Node *top) const {
@@ -34,8 +85,25 @@ std::string Node::handle_name(const Node *top) const {
     return string::join(reorder_names.begin(), reorder_names.end(), ".");
 }
 
+const NodeInfo &Node::info() const {
+    static const NodeInfo empty;
+    return info_ ? *info_ : empty;
+}
+
+NodeInfo &Node::mutable_info() {
+    if (!info_) info_ = std::make_unique<NodeInfo>();
+    return *info_;
+}
+
+std::string Node::value_str() const {
+    return wide_value ? wide_value->str() : std::to_string(value);
+}
+
 bool Node::child_of(const Node *node) const {
     if (!node) return false;
+    if (hierarchy_pre && node->hierarchy_pre) {
+        return node->hierarchy_pre < hierarchy_pre && hierarchy_post < node->hierarchy_post;
+    }
     auto p = parent;
     while (p) {
         if (p != node) {
@@ -81,32 +149,13 @@ bool Graph::has_path(const Node *from, const Node *to, uint64_t max_depth) {
 
 bool Graph::has_path(const Node *from, const Node *to,
                      const std::function<bool(const Edge *)> &cond) {
-    // DFS based search
-    std::stack<const Node *> nodes;
-    std::unordered_set<const Node *> visited;
-    nodes.emplace(from);
-    while (!nodes.empty()) {
-        auto n = nodes.top();
-        nodes.pop();
-        if (n->id == to->id) {
-            return true;
-        }
-        auto const &edges = n->edges_to;
-        for (auto const &nn : edges) {
-            if (visited.find(nn->to) != visited.end()) continue;
-            bool add_cond = cond(nn.get());
-            if (add_cond) nodes.push(nn->to);
-        }
-        visited.emplace(n);
-    }
-    return false;
+    return has_path(from, to, [&cond](const Edge *edge) { return cond(edge); });
 }
 
 Node *Graph::select(const std::string &name) {
     // this is a tree traversal search
-    auto tokens = string::get_tokens(name, ".");
-    std::queue<std::string> search_names;
-    for (auto const &n : tokens) {
+    std::queue<std::string_view> search_names;
+    for (auto const &n : string::split(name, ".")) {
         search_names.push(n);
     }
 
@@ -119,7 +168,7 @@ Node *Graph::select(const std::string &name) {
         std::transform(nodes_.begin() + cache_nodes_.size(), nodes_.end(),
                        std::back_inserter(cache_nodes_), [](const auto &ptr) { return ptr.get(); });
     }
-    auto nodes = &cache_nodes_;
+    const std::vector<Node *> *nodes = &cache_nodes_;
 
     while (i < nodes->size() && !search_names.empty()) {
         auto const &target_name = search_names.front();
@@ -130,7 +179,7 @@ Node *Graph::select(const std::string &name) {
             // narrow the scope
             // reset search scope and counter
             i = 0;
-            nodes = &node->children;
+            nodes = &node->info().children;
         } else {
             i++;
         }
@@ -139,101 +188,127 @@ Node *Graph::select(const std::string &name) {
     return nullptr;
 }
 
-void Graph::identify_registers() {
-    for (auto &node : nodes_) {
-        // it has to be named
-        if (node->name.empty()) continue;
-        // has to be an variable
-        if (node->type != NodeType::Net && node->type != NodeType::Variable) continue;
-        bool non_blocking = true;
-        for (auto const &edge : node->edges_from) {
-            if (edge->from->has_type(NodeType::Assign) && edge->type == EdgeType::Blocking) {
-                non_blocking = false;
-                break;
-            }
+// number of nodes each task processes when scanning the entire graph
+constexpr uint64_t NODE_CHUNK_SIZE = 1u << 14u;
+
+uint64_t num_node_chunks(uint64_t size) { return (size + NODE_CHUNK_SIZE - 1) / NODE_CHUNK_SIZE; }
+
+// calls func(chunk, begin, end) for every chunk of [0, size), in parallel if there is more than
+// one chunk. each chunk writes to its own output so that the result order is deterministic
+template <typename F>
+void for_each_node_chunk(uint64_t size, F &&func) {
+    auto num_chunks = num_node_chunks(size);
+    auto num_cpus = get_num_cpus();
+    if (num_chunks <= 1 || num_cpus <= 1) {
+        for (uint64_t i = 0; i < num_chunks; i++) {
+            func(i, i * NODE_CHUNK_SIZE, std::min(size, (i + 1) * NODE_CHUNK_SIZE));
         }
-        // it has to be non-blocking
-        if (!non_blocking) continue;
+        return;
+    }
 
-        if (!node->edges_from.empty()) {
-            // this is a registers
-            node->type = node->type | NodeType::Register;
+    cxxpool::thread_pool pool{std::min<uint64_t>(num_cpus, num_chunks)};
+    std::vector<std::future<void>> tasks;
+    tasks.reserve(num_chunks);
+    for (uint64_t i = 0; i < num_chunks; i++) {
+        tasks.emplace_back(pool.push([&func, i, size]() {
+            ScopedTrace trace("node_chunk", "chunk");
+            func(i, i * NODE_CHUNK_SIZE, std::min(size, (i + 1) * NODE_CHUNK_SIZE));
+        }));
+    }
+    for (auto &t : tasks) {
+        t.wait();
+    }
+    for (auto &t : tasks) {
+        t.get();
+    }
+}
+
+bool is_register(const Node *node) {
+    // it has to be named
+    if (node->name.empty()) return false;
+    // has to be an variable
+    auto type = static_cast<NodeType>(static_cast<uint32_t>(node->type) &
+                                      ~static_cast<uint32_t>(NodeType::Register));
+    if (type != NodeType::Net && type != NodeType::Variable) return false;
+    // it has to be non-blocking
+    for (auto const &edge : node->edges_from) {
+        if (edge->from->has_type(NodeType::Assign) && edge->type == EdgeType::Blocking) {
+            return false;
         }
     }
+    return !node->edges_from.empty();
 }
 
-std::vector<Node *> Graph::get_registers() const {
-    std::vector<Node *> result;
-    // this is just a approximation
-    result.reserve(static_cast<uint64_t>(std::sqrt(nodes_.size())));
-    for (auto const &node : nodes_) {
-        if (node->has_type(NodeType::Register)) {
-            result.emplace_back(node.get());
+template <typename GetNode>
+void classify_registers(uint64_t size, GetNode get_node) {
+    // nodes are only read when classifying, and updated afterwards. otherwise we would race
+    // with other threads reading the node type
+    std::vector<std::vector<Node *>> changed(num_node_chunks(size));
+    for_each_node_chunk(size, [&](uint64_t chunk, uint64_t begin, uint64_t end) {
+        auto &result = changed[chunk];
+        for (uint64_t i = begin; i < end; i++) {
+            Node *node = get_node(i);
+            if (is_register(node) != node->has_type(NodeType::Register)) {
+                result.emplace_back(node);
+            }
+        }
+    });
+    for (auto const &nodes : changed) {
+        for (auto node : nodes) {
+            node->type = static_cast<NodeType>(static_cast<uint32_t>(node->type) ^
+                                               static_cast<uint32_t>(NodeType::Register));
         }
     }
-    return result;
 }
 
-bool constant_driver(const Node *node, std::unordered_set<const Node *> &self_assignment_nodes,
-                     std::unordered_set<const Edge *> &const_sources) {
-    // we allow self loop
-    self_assignment_nodes.emplace(node);
-    auto const &edges = node->edges_from;
-    if (edges.empty()) {
-        // no visible driver
-        return false;
+void Graph::identify_registers() {
+    classify_registers(nodes_.size(), [this](uint64_t i) { return nodes_[i].get(); });
+    num_classified_nodes_ = nodes_.size();
+    touched_nodes_.clear();
+}
+
+void Graph::identify_registers_incremental() {
+    std::vector<Node *> nodes(touched_nodes_.begin(), touched_nodes_.end());
+    for (auto i = num_classified_nodes_; i < nodes_.size(); i++) {
+        auto node = nodes_[i].get();
+        nodes.emplace_back(node);
+        // new assignments to existing variables
+        for (auto const &edge : node->edges_to) nodes.emplace_back(edge->to);
     }
-    bool result = true;
-    for (auto const &edge : edges) {
-        // if it is a slice, we need to go a skip?
-        if (edge->has_type(EdgeType::Slice)) {
-            continue;
-        }
+    // each node can only be classified once
+    std::sort(nodes.begin(), nodes.end());
+    nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
 
-        auto const node_from = edge->from;
-        // this is part of the loop group
-        if (self_assignment_nodes.find(node_from) != self_assignment_nodes.end()) {
-            continue;
-        }
-        if (node_from->has_type(NodeType::Assign) || node_from->has_type(NodeType::Variable)) {
-            // need to figure out the source
-            auto node_result = constant_driver(node_from, self_assignment_nodes, const_sources);
-            if (!node_result) {
-                result = false;
-                break;
-            }
-        } else if (node_from->has_type(NodeType::Net)) {
-            // NOTE::
-            // 1. this is a herustics on how people write FSM that doesn't follow traditional
-            // convention, e.g., additions
-            // we only allow self loop with limited ops, such as add, and subtract
-            // 2. if it's a net with name, i.e., wire/reg/logic, we continue the search
-            if ((node_from->op != NetOpType::Ignore && node_from->edges_from.size() <= 2) ||
-                !node_from->name.empty()) {
-                auto node_result = constant_driver(node_from, self_assignment_nodes, const_sources);
-                if (!node_result) {
-                    result = false;
-                    break;
-                }
-            } else {
-                result = false;
-                break;
+    classify_registers(nodes.size(), [&nodes](uint64_t i) { return nodes[i]; });
+    num_classified_nodes_ = nodes_.size();
+    touched_nodes_.clear();
+}
+
+std::vector<Node *> Graph::get_registers() const {
+    std::vector<std::vector<Node *>> registers(num_node_chunks(nodes_.size()));
+    for_each_node_chunk(nodes_.size(), [&](uint64_t chunk, uint64_t begin, uint64_t end) {
+        auto &result = registers[chunk];
+        for (uint64_t i = begin; i < end; i++) {
+            auto node = nodes_[i].get();
+            if (node->has_type(NodeType::Register)) {
+                result.emplace_back(node);
             }
-        } else if (node_from->has_type(NodeType::Control)) {
-            // this is allowed as this is the node that controls whether to assign or not
-            // but no recursive call
-            continue;
-        } else if (!node_from->has_type(NodeType::Constant)) {
-            result = false;
-            break;
-        } else {
-            assert_(node_from->type == NodeType::Constant, "node type has to be constant");
-            const_sources.emplace(edge);
         }
-    }
+    });
 
+    std::vector<Node *> result;
+    uint64_t size = 0;
+    for (auto const &nodes : registers) size += nodes.size();
+    result.reserve(size);
+    for (auto const &nodes : registers) result.insert(result.end(), nodes.begin(), nodes.end());
+    return result;
+}
+
+bool finish_constant_driver(const Node *node, bool result,
+                            std::unordered_set<const Edge *> &const_sources) {
     // if all the edges are controls, then it shouldn't be a constant driver
     {
+        auto const &edges = node->edges_from;
         uint32_t num_control = 0;
         for (auto const &edge : edges) {
             if (edge->from->type == NodeType::Control) {
@@ -255,6 +330,108 @@ bool constant_driver(const Node *node, std::unordered_set<const Node *> &self_as
     return result;
 }
 
+bool constant_driver(const Node *node, std::unordered_set<const Node *> &self_assignment_nodes,
+                     std::unordered_set<const Edge *> &const_sources) {
+    // this used to be a recursive search, which overflows the stack on long assignment chains.
+    // each frame is a pending call and the edge it is currently looking at
+    struct Frame {
+        const Node *node;
+        std::unordered_set<Edge *>::const_iterator edge;
+    };
+    std::vector<Frame> stack;
+
+    // we allow self loop
+    self_assignment_nodes.emplace(node);
+    if (node->edges_from.empty()) {
+        // no visible driver
+        return false;
+    }
+    stack.emplace_back(Frame{node, node->edges_from.begin()});
+
+    // return value of the last finished call
+    bool result = true;
+    bool returned = false;
+    while (!stack.empty()) {
+        auto &frame = stack.back();
+        auto const &edges = frame.node->edges_from;
+        bool frame_result = true;
+        bool finished = false;
+        if (returned) {
+            returned = false;
+            if (result) {
+                frame.edge++;
+            } else {
+                frame_result = false;
+                finished = true;
+            }
+        }
+
+        const Node *callee = nullptr;
+        while (!finished && frame.edge != edges.end()) {
+            auto const edge = *frame.edge;
+            // if it is a slice, we need to go a skip?
+            if (edge->has_type(EdgeType::Slice)) {
+                frame.edge++;
+                continue;
+            }
+
+            auto const node_from = edge->from;
+            // this is part of the loop group
+            if (self_assignment_nodes.find(node_from) != self_assignment_nodes.end()) {
+                frame.edge++;
+                continue;
+            }
+            if (node_from->has_type(NodeType::Assign) || node_from->has_type(NodeType::Variable)) {
+                // need to figure out the source
+                callee = node_from;
+                break;
+            } else if (node_from->has_type(NodeType::Net)) {
+                // NOTE::
+                // 1. this is a herustics on how people write FSM that doesn't follow traditional
+                // convention, e.g., additions
+                // we only allow self loop with limited ops, such as add, and subtract
+                // 2. if it's a net with name, i.e., wire/reg/logic, we continue the search
+                if ((node_from->op != NetOpType::Ignore && node_from->edges_from.size() <= 2) ||
+                    !node_from->name.empty()) {
+                    callee = node_from;
+                    break;
+                } else {
+                    frame_result = false;
+                    finished = true;
+                }
+            } else if (node_from->has_type(NodeType::Control)) {
+                // this is allowed as this is the node that controls whether to assign or not
+                // but no recursive call
+                frame.edge++;
+            } else if (!node_from->has_type(NodeType::Constant)) {
+                frame_result = false;
+                finished = true;
+            } else {
+                assert_(node_from->type == NodeType::Constant, "node type has to be constant");
+                const_sources.emplace(edge);
+                frame.edge++;
+            }
+        }
+
+        if (callee) {
+            self_assignment_nodes.emplace(callee);
+            if (!callee->edges_from.empty()) {
+                // frame is invalidated after this
+                stack.emplace_back(Frame{callee, callee->edges_from.begin()});
+                continue;
+            }
+            // no visible driver
+            frame_result = false;
+        }
+
+        result = finish_constant_driver(frame.node, frame_result, const_sources);
+        stack.pop_back();
+        returned = true;
+    }
+
+    return result;
+}
+
 bool Graph::constant_driver(const Node *node) {
     std::unordered_set<const Node *> self_nodes;
     std::unordered_set<const Edge *> const_nodes;
@@ -262,24 +439,12 @@ bool Graph::constant_driver(const Node *node) {
 }
 
 bool Graph::reachable(const Node *from, const Node *to) {
-    // BFS search
-    std::queue<const Node *> working_set;
-    std::unordered_set<const Node *> visited;
-    working_set.emplace(from);
     // edge case
     if (from->edges_to.empty()) return false;
-
-    while (!working_set.empty()) {
-        auto n = working_set.front();
-        working_set.pop();
-        if (n == to) return true;
-        if (visited.find(n) != visited.end()) continue;
-        visited.emplace(n);
-        for (auto const &edge : n->edges_to) {
-            working_set.emplace(edge->to);
-        }
-    }
-    return false;
+    if (from == to) return true;
+    return breadth_first(from, [to](const Edge *edge) {
+        return edge->to == to ? Step::Stop : Step::Follow;
+    });
 }
 
 bool Graph::has_loop(const Node *node) { return reachable(node, node); }
@@ -371,12 +536,12 @@ std::vector<const Node *> Graph::find_sinks(const Node *node, uint32_t depth) {
             continue;
         }
         uint32_t current_level = d + 1;
-        for (auto const &edge : n->edges_to) {
-            if (edge->has_type(EdgeType::Control)) continue;
+        for_each_edge_to<CONTROL_EDGES>(n, [&](const Edge *edge) {
             auto const nn = edge->to;
             level_nodes.emplace(nn, current_level);
             working_set.emplace(nn);
-        }
+            return true;
+        });
         result.emplace_back(n);
     }
 
@@ -395,7 +560,33 @@ bool is_counter_op(const Node *node) {
     return node->op == NetOpType::Add || node->op == NetOpType::Subtract;
 }
 
-bool is_counter_(const Node *target, const Node *node) {
+// Graph::reachable(from, node) for many nodes. the nodes reachable from from are only collected
+// on the first query, since most FSM candidates never ask
+class ForwardReachable {
+public:
+    explicit ForwardReachable(const Node *from) : from_(from) {}
+
+    bool contains(const Node *node) {
+        // same edge cases as Graph::reachable
+        if (from_->edges_to.empty()) return false;
+        if (node == from_) return true;
+        if (!computed_) {
+            breadth_first(from_, [this](const Edge *edge) {
+                nodes_.emplace(edge->to);
+                return Step::Follow;
+            });
+            computed_ = true;
+        }
+        return nodes_.find(node) != nodes_.end();
+    }
+
+private:
+    const Node *from_;
+    bool computed_ = false;
+    std::unordered_set<const Node *> nodes_;
+};
+
+bool is_counter_(const Node *target, const Node *node, ForwardReachable &from_target) {
     // if there is any + or - based operator on the target node
     // first we do a search and figure out every assigned nodes
     // BFS based search
@@ -413,7 +604,7 @@ bool is_counter_(const Node *target, const Node *node) {
             for (auto const edge : edges_from) {
                 if (!edge->has_type(EdgeType::Control)) {
                     auto nn = edge->from;
-                    if (Graph::reachable(target, nn) && is_counter_op(nn)) {
+                    if (is_counter_op(nn) && from_target.contains(nn)) {
                         return true;
                     }
                 }
@@ -431,15 +622,17 @@ bool is_counter_(const Node *target, const Node *node) {
 bool Graph::is_counter(const Node *node, const std::unordered_set<const Edge *> &edges) {
     // we do a filtering to speed up the process
     // if it is a counter, it's unlikely it will be mixed with explicit state
-    std::unordered_map<int64_t, const Edge *> const_edges;
+    std::unordered_map<ConstantValue, const Edge *, ConstantValueHash> const_edges;
     for (auto const &edge : edges) {
         auto const node_from = edge->from;
         assert_(node_from->type == NodeType::Constant, "fsm state has to be driven by constant");
-        if (const_edges.find(node_from->value) == const_edges.end()) {
-            const_edges.emplace(node_from->value, edge);
+        if (const_edges.find(node_from->value_key()) == const_edges.end()) {
+            const_edges.emplace(node_from->value_key(), edge);
         }
     }
     uint32_t arith_count = 0;
+    // shared by every assignment, so the fan-out of the node is searched at most once
+    ForwardReachable from_node(node);
     for (auto const &iter : const_edges) {
         auto const edge = iter.second;
         auto assign_to = edge->to;
@@ -456,7 +649,7 @@ bool Graph::is_counter(const Node *node, const std::unordered_set<const Edge *>
         assert_(assign_to->edges_to.size() == 1);
         auto edge_to = assign_to->edges_to.front().get();
         const Node *n = edge_to->to;
-        auto r = is_counter_(node, n);
+        auto r = is_counter_(node, n, from_node);
         if (r) {
             arith_count++;
         }
@@ -473,107 +666,373 @@ bool Graph::is_counter(const Node *node, const std::unordered_set<const Edge *>
 
 bool Graph::in_direct_assign_chain(const Node *from, const Node *to) {
     if (from == to) return true;
-    std::queue<const Node *> working_set;
-    std::unordered_set<const Node *> visited;
-    working_set.emplace(from);
-
-    while (!working_set.empty()) {
-        auto node = working_set.front();
-        working_set.pop();
-        if (visited.find(node) != visited.end()) continue;
-        visited.emplace(node);
-
-        for (auto const &edge : node->edges_to) {
-            if (!edge->has_type(EdgeType::Control)) {
-                auto n = edge->to;
-                if (n == to) return true;
-                if (n->has_type(NodeType::Assign)) {
-                    // just to make sure that this is the only assignment we have
-                    uint32_t num_direct_assign = 0;
-                    for (auto edge_from : n->edges_from) {
-                        if (edge_from->has_type(EdgeType::Blocking) ||
-                            edge_from->has_type(EdgeType::NonBlocking))
-                            num_direct_assign++;
-                    }
-                    if (num_direct_assign == 1) working_set.emplace(n);
-                }
-            }
+    return breadth_first<edge_mask(EdgeType::Control)>(from, [to](const Edge *edge) {
+        auto n = edge->to;
+        if (n == to) return Step::Stop;
+        if (!n->has_type(NodeType::Assign)) return Step::Skip;
+        // just to make sure that this is the only assignment we have
+        uint32_t num_direct_assign = 0;
+        for (auto edge_from : n->edges_from) {
+            if (edge_from->has_type(EdgeType::Blocking) ||
+                edge_from->has_type(EdgeType::NonBlocking))
+                num_direct_assign++;
         }
-    }
-
-    return false;
+        return num_direct_assign == 1 ? Step::Follow : Step::Skip;
+    });
 }
 
 std::unordered_set<const Edge *> Graph::find_connection_cond(
     const Node *from, const std::function<bool(const Edge *)> &predicate) {
-    return find_connection_cond(from, predicate, [](const Edge *) { return false; });
+    return find_connection_cond(from, [&predicate](const Edge *edge) { return predicate(edge); });
 }
 
 std::unordered_set<const Edge *> Graph::find_connection_cond(
     const Node *from, const std::function<bool(const Edge *)> &predicate,
     const std::function<bool(const Edge *)> &terminate) {
-    std::unordered_set<const Edge *> result;
-    std::queue<const Node *> working_set;
-    std::unordered_set<const Node *> visited;
-    working_set.emplace(from);
+    return find_connection_cond(
+        from, [&predicate](const Edge *edge) { return predicate(edge); },
+        [&terminate](const Edge *edge) { return terminate(edge); });
+}
 
-    while (!working_set.empty()) {
-        auto node = working_set.front();
-        working_set.pop();
-        if (visited.find(node) != visited.end()) continue;
-        visited.emplace(node);
+std::vector<const Node *> Graph::route(const Node *from, const Node *to,
+                                       const std::function<bool(const Edge *)> &predicate,
+                                       uint32_t depth) {
+    return route(
+        from, to, [&predicate](const Edge *edge) { return predicate(edge); }, depth);
+}
 
+RouteEngine::RouteEngine(std::function<bool(const Edge *)> predicate, uint32_t max_length)
+    : predicate_(std::move(predicate)), max_length_(max_length) {}
+
+uint32_t RouteEngine::index(const Node *node) {
+    auto [it, inserted] = indices_.emplace(node, static_cast<uint32_t>(nodes_.size()));
+    if (inserted) {
+        nodes_.emplace_back(node);
+        fan_out_.emplace_back();
+        fan_in_.emplace_back();
+        forward_.emplace_back();
+        backward_.emplace_back();
+        target_stamp_.emplace_back(0);
+    }
+    return it->second;
+}
+
+const std::vector<RouteEngine::Link> &RouteEngine::fan_out(uint32_t index) {
+    if (!fan_out_[index].cached) {
+        // index() may grow the tables, so build the links first
+        std::vector<Link> links;
+        auto const *node = nodes_[index];
+        links.reserve(node->edges_to.size());
         for (auto const &edge : node->edges_to) {
-            if (!terminate(edge.get())) working_set.emplace(edge->to);
-            if (predicate(edge.get())) {
-                result.emplace(edge.get());
+            links.emplace_back(Link{this->index(edge->to), edge.get(), predicate_(edge.get())});
+        }
+        fan_out_[index].links = std::move(links);
+        fan_out_[index].cached = true;
+    }
+    return fan_out_[index].links;
+}
+
+const std::vector<RouteEngine::Link> &RouteEngine::fan_in(uint32_t index) {
+    if (!fan_in_[index].cached) {
+        std::vector<Link> links;
+        auto const *node = nodes_[index];
+        links.reserve(node->edges_from.size());
+        for (auto const *edge : node->edges_from) {
+            links.emplace_back(Link{this->index(edge->from), edge, predicate_(edge)});
+        }
+        fan_in_[index].links = std::move(links);
+        fan_in_[index].cached = true;
+    }
+    return fan_in_[index].links;
+}
+
+void RouteEngine::next_search() {
+    if (++stamp_ == 0) {
+        // wrapped around, stale stamps may collide with the new ones
+        for (auto &v : forward_) v.stamp = 0;
+        for (auto &v : backward_) v.stamp = 0;
+        std::fill(target_stamp_.begin(), target_stamp_.end(), 0);
+        stamp_ = 1;
+    }
+}
+
+RouteEngine::Path RouteEngine::forward_path(uint32_t index) const {
+    Path path;
+    while (forward_[index].edge) {
+        path.emplace_back(forward_[index].edge);
+        index = forward_[index].parent;
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+RouteEngine::Path RouteEngine::route(const Node *from, const Node *to) {
+    if (from == to) return {};
+    next_search();
+    auto source = index(from);
+    auto target = index(to);
+    forward_[source] = {stamp_, 0, source, nullptr};
+    backward_[target] = {stamp_, 0, target, nullptr};
+
+    std::vector<uint32_t> forward_frontier = {source};
+    std::vector<uint32_t> backward_frontier = {target};
+    std::vector<uint32_t> next;
+    uint32_t forward_depth = 0, backward_depth = 0;
+    uint32_t meet = 0;
+    auto best = std::numeric_limits<uint32_t>::max();
+
+    // expand the smaller frontier one level at a time. the whole level is finished before
+    // stopping so that the shortest meeting point is picked
+    while (best == std::numeric_limits<uint32_t>::max() && !forward_frontier.empty() &&
+           !backward_frontier.empty()) {
+        if (max_length_ > 0 && forward_depth + backward_depth >= max_length_) break;
+        next.clear();
+        if (forward_frontier.size() <= backward_frontier.size()) {
+            for (auto n : forward_frontier) {
+                for (auto const &link : fan_out(n)) {
+                    // the last edge doesn't need to satisfy the predicate
+                    if (!link.allowed && link.node != target) continue;
+                    auto &visit = forward_[link.node];
+                    if (visit.stamp == stamp_) continue;
+                    visit = {stamp_, forward_depth + 1, n, link.edge};
+                    if (backward_[link.node].stamp == stamp_ &&
+                        visit.depth + backward_[link.node].depth < best) {
+                        best = visit.depth + backward_[link.node].depth;
+                        meet = link.node;
+                    }
+                    next.emplace_back(link.node);
+                }
             }
+            forward_depth++;
+            std::swap(forward_frontier, next);
+        } else {
+            for (auto n : backward_frontier) {
+                for (auto const &link : fan_in(n)) {
+                    if (!link.allowed && n != target) continue;
+                    auto &visit = backward_[link.node];
+                    if (visit.stamp == stamp_) continue;
+                    visit = {stamp_, backward_depth + 1, n, link.edge};
+                    if (forward_[link.node].stamp == stamp_ &&
+                        visit.depth + forward_[link.node].depth < best) {
+                        best = visit.depth + forward_[link.node].depth;
+                        meet = link.node;
+                    }
+                    next.emplace_back(link.node);
+                }
+            }
+            backward_depth++;
+            std::swap(backward_frontier, next);
         }
     }
-    return result;
+    if (best == std::numeric_limits<uint32_t>::max()) return {};
+
+    auto path = forward_path(meet);
+    while (backward_[meet].edge) {
+        path.emplace_back(backward_[meet].edge);
+        meet = backward_[meet].parent;
+    }
+    return path;
 }
 
-std::vector<const Node *> Graph::route(const Node *from, const Node *to,
-                                       const std::function<bool(const Edge *)> &predicate,
-                                       uint32_t depth) {
-    std::queue<const Node *> working_set;
-    std::unordered_map<const Node *, uint32_t> known_depth{{from, 0}};
-    std::unordered_set<const Node *> visited;
-    working_set.emplace(from);
-    std::unordered_map<const Node *, const Node *> trace;
-    bool found = false;
+std::vector<RouteEngine::Path> RouteEngine::route(const std::vector<Query> &queries) {
+    std::vector<Path> result(queries.size());
+    // group the queries by source, in the order they first show up
+    std::vector<const Node *> sources;
+    std::unordered_map<const Node *, std::vector<uint64_t>> groups;
+    for (uint64_t i = 0; i < queries.size(); i++) {
+        auto [it, inserted] = groups.emplace(queries[i].first, std::vector<uint64_t>{});
+        if (inserted) sources.emplace_back(queries[i].first);
+        it->second.emplace_back(i);
+    }
 
-    while (!working_set.empty() && !found) {
-        auto node = working_set.front();
-        working_set.pop();
-        if (visited.find(node) != visited.end()) continue;
-        visited.emplace(node);
-        auto current_depth = known_depth.at(node);
-        if (depth > 0 && current_depth > depth) continue;
+    std::vector<uint32_t> working_set;
+    for (auto const *from : sources) {
+        auto const &group = groups.at(from);
+        next_search();
+        auto source = index(from);
+        uint64_t remaining = 0;
+        for (auto i : group) {
+            auto target = index(queries[i].second);
+            if (target != source && target_stamp_[target] != stamp_) {
+                target_stamp_[target] = stamp_;
+                remaining++;
+            }
+        }
+
+        // plain breadth-first search. targets record the first edge that reaches them, which
+        // doesn't need to satisfy the predicate, in backward_
+        forward_[source] = {stamp_, 0, source, nullptr};
+        working_set.clear();
+        working_set.emplace_back(source);
+        for (uint64_t head = 0; head < working_set.size() && remaining > 0; head++) {
+            auto n = working_set[head];
+            auto depth = forward_[n].depth;
+            if (max_length_ > 0 && depth >= max_length_) break;
+            for (auto const &link : fan_out(n)) {
+                if (target_stamp_[link.node] == stamp_ && backward_[link.node].stamp != stamp_) {
+                    backward_[link.node] = {stamp_, depth + 1, n, link.edge};
+                    remaining--;
+                }
+                if (!link.allowed || forward_[link.node].stamp == stamp_) continue;
+                forward_[link.node] = {stamp_, depth + 1, n, link.edge};
+                working_set.emplace_back(link.node);
+            }
+        }
+
+        for (auto i : group) {
+            auto const &visit = backward_[indices_.at(queries[i].second)];
+            if (visit.stamp != stamp_) continue;
+            auto &path = result[i];
+            path = forward_path(visit.parent);
+            path.emplace_back(visit.edge);
+        }
+    }
+    return result;
+}
+
+ReachabilityEngine::ReachabilityEngine(std::function<bool(const Edge *)> predicate,
+                                       uint32_t max_length)
+    : predicate_(std::move(predicate)), max_length_(max_length) {}
+
+uint32_t ReachabilityEngine::index(const Node *node) {
+    auto [it, inserted] = indices_.emplace(node, static_cast<uint32_t>(nodes_.size()));
+    if (inserted) {
+        nodes_.emplace_back(node);
+        fan_out_.emplace_back();
+        reached_.emplace_back(0);
+        seen_.emplace_back(0);
+        frontier_.emplace_back(0);
+        next_.emplace_back(0);
+        wanted_.emplace_back(0);
+    }
+    return it->second;
+}
 
+const std::vector<ReachabilityEngine::Link> &ReachabilityEngine::fan_out(uint32_t index) {
+    if (!fan_out_[index].cached) {
+        // index() may grow the tables, so build the links first
+        std::vector<Link> links;
+        auto const *node = nodes_[index];
+        links.reserve(node->edges_to.size());
         for (auto const &edge : node->edges_to) {
-            auto node_to = edge->to;
-            trace.emplace(node_to, node);
-            if (node_to == to) {
-                found = true;
-                break;
+            links.emplace_back(Link{this->index(edge->to), !predicate_ || predicate_(edge.get())});
+        }
+        fan_out_[index].links = std::move(links);
+        fan_out_[index].cached = true;
+    }
+    return fan_out_[index].links;
+}
+
+void ReachabilityEngine::search(const std::vector<uint32_t> &sources,
+                                const std::vector<uint32_t> &targets) {
+    ScopedTrace trace("reachable", "batch");
+    std::fill(reached_.begin(), reached_.end(), 0);
+    std::fill(seen_.begin(), seen_.end(), 0);
+    std::vector<uint32_t> frontier, next;
+    for (uint64_t i = 0; i < sources.size(); i++) {
+        auto source = sources[i];
+        if (!frontier_[source]) frontier.emplace_back(source);
+        frontier_[source] |= 1ull << i;
+        seen_[source] |= 1ull << i;
+    }
+
+    // stop early once every target has been reached by all the sources that ask for it
+    uint64_t remaining = targets.size();
+    for (uint32_t depth = 0; !frontier.empty() && remaining > 0; depth++) {
+        if (max_length_ > 0 && depth >= max_length_) break;
+        next.clear();
+        for (auto n : frontier) {
+            auto bits = frontier_[n];
+            for (auto const &link : fan_out(n)) {
+                auto v = link.node;
+                auto reached = reached_[v] | bits;
+                if (reached != reached_[v]) {
+                    auto wanted = wanted_[v];
+                    auto done = (reached_[v] & wanted) == wanted;
+                    if (wanted && !done && (reached & wanted) == wanted) remaining--;
+                    reached_[v] = reached;
+                }
+                // the last edge doesn't need to satisfy the predicate
+                if (!link.allowed) continue;
+                auto expand = bits & ~seen_[v];
+                if (!expand) continue;
+                if (!next_[v]) next.emplace_back(v);
+                next_[v] |= expand;
             }
-            if (!predicate(edge.get())) continue;
-            working_set.emplace(node_to);
-            known_depth.emplace(node_to, current_depth + 1);
         }
+        for (auto n : frontier) frontier_[n] = 0;
+        for (auto n : next) {
+            seen_[n] |= next_[n];
+            frontier_[n] = next_[n];
+            next_[n] = 0;
+        }
+        std::swap(frontier, next);
     }
-    if (trace.find(to) == trace.end()) return {};
-    std::vector<const Node *> path;
-    auto temp = to;
-    while (trace.find(temp) != trace.end() && temp != from) {
-        path.emplace_back(temp);
-        temp = trace.at(temp);
+    for (auto n : frontier) frontier_[n] = 0;
+    for (auto n : targets) wanted_[n] = 0;
+}
+
+std::vector<bool> ReachabilityEngine::reachable(const std::vector<Query> &queries) {
+    std::vector<bool> result(queries.size(), false);
+    // group the queries by source, in the order they first show up
+    std::vector<const Node *> sources;
+    std::unordered_map<const Node *, std::vector<uint64_t>> groups;
+    for (uint64_t i = 0; i < queries.size(); i++) {
+        auto [it, inserted] = groups.emplace(queries[i].first, std::vector<uint64_t>{});
+        if (inserted) sources.emplace_back(queries[i].first);
+        it->second.emplace_back(i);
     }
-    assert_(temp == from, "unable to compute trace");
 
-    std::reverse(path.begin(), path.end());
-    return path;
+    std::vector<uint32_t> batch, targets;
+    for (uint64_t begin = 0; begin < sources.size(); begin += BATCH_SIZE) {
+        auto end = std::min<uint64_t>(begin + BATCH_SIZE, sources.size());
+        batch.clear();
+        targets.clear();
+        for (auto s = begin; s < end; s++) {
+            batch.emplace_back(index(sources[s]));
+            for (auto i : groups.at(sources[s])) {
+                auto target = index(queries[i].second);
+                if (!wanted_[target]) targets.emplace_back(target);
+                wanted_[target] |= 1ull << (s - begin);
+            }
+        }
+        search(batch, targets);
+        for (auto s = begin; s < end; s++) {
+            for (auto i : groups.at(sources[s])) {
+                result[i] = reached_[indices_.at(queries[i].second)] & (1ull << (s - begin));
+            }
+        }
+    }
+    return result;
+}
+
+std::vector<std::vector<bool>> ReachabilityEngine::reachable(
+    const std::vector<const Node *> &sources, const std::vector<const Node *> &targets) {
+    std::vector<std::vector<bool>> result(sources.size(), std::vector<bool>(targets.size()));
+    std::vector<uint32_t> target_indices;
+    target_indices.reserve(targets.size());
+    for (auto const *target : targets) target_indices.emplace_back(index(target));
+    // a target might show up more than once
+    std::vector<uint32_t> unique_targets = target_indices;
+    std::sort(unique_targets.begin(), unique_targets.end());
+    unique_targets.erase(std::unique(unique_targets.begin(), unique_targets.end()),
+                         unique_targets.end());
+
+    std::vector<uint32_t> batch;
+    for (uint64_t begin = 0; begin < sources.size(); begin += BATCH_SIZE) {
+        auto end = std::min<uint64_t>(begin + BATCH_SIZE, sources.size());
+        batch.clear();
+        for (auto s = begin; s < end; s++) batch.emplace_back(index(sources[s]));
+        auto mask = end - begin == BATCH_SIZE ? ~0ull : (1ull << (end - begin)) - 1;
+        for (auto target : unique_targets) wanted_[target] = mask;
+        search(batch, unique_targets);
+        for (auto s = begin; s < end; s++) {
+            for (uint64_t t = 0; t < targets.size(); t++) {
+                result[s][t] = reached_[target_indices[t]] & (1ull << (s - begin));
+            }
+        }
+    }
+    return result;
 }
 
 std::vector<FSMResult> Graph::identify_fsms() { return identify_fsms(nullptr); }
@@ -581,6 +1040,8 @@ std::vector<FSMResult> Graph::identify_fsms() { return identify_fsms(nullptr); }
 std::vector<FSMResult> Graph::identify_fsms(const Node *top) {
     std::vector<FSMResult> result;
 
+    // the hierarchy doesn't change from here on
+    label_hierarchy();
     // first it has to be a register
     identify_registers();
     auto registers = get_registers();
@@ -592,12 +1053,19 @@ std::vector<FSMResult> Graph::identify_fsms(const Node *top) {
     tasks.reserve(registers.size());
     uint64_t count = 0;
     uint64_t num_registers = registers.size();
+    // why the candidates are rejected, reported as stats
+    std::atomic<uint64_t> pruned_constant_source = 0, pruned_control_loop = 0, pruned_states = 0;
 
     for (auto reg : registers) {
         if (top && !reg->child_of(top)) continue;
         // I think the constant driver is faster?
-        auto t = pool.push([reg, &mutex, &count, &bar, num_registers, &result]() -> void {
+        auto t = pool.push([reg, &mutex, &count, &bar, num_registers, &result,
+                            &pruned_constant_source, &pruned_control_loop,
+                            &pruned_states]() -> void {
+            ScopedTrace trace("identify_fsms", "register", reg);
+            ScopedTrace wait("wait", "mutex");
             mutex.lock();
+            wait.stop();
             count++;
             bar.progress(count, num_registers);
             mutex.unlock();
@@ -613,12 +1081,19 @@ std::vector<FSMResult> Graph::identify_fsms(const Node *top) {
                     // filter result
                     if (!fsm.is_counter()) {
                         auto states = fsm.unique_states();
-                        if (states.size() < 2) return;
+                        if (states.size() < 2) {
+                            pruned_states++;
+                            return;
+                        }
                     }
                     mutex.lock();
                     result.emplace_back(fsm);
                     mutex.unlock();
+                } else {
+                    pruned_control_loop++;
                 }
+            } else {
+                pruned_constant_source++;
             }
         });
         tasks.emplace_back(std::move(t));
@@ -631,13 +1106,103 @@ std::vector<FSMResult> Graph::identify_fsms(const Node *top) {
         t.get();
     }
 
+    auto &stats = Stats::instance();
+    stats.count("registers", tasks.size());
+    stats.count("pruned_constant_source", pruned_constant_source);
+    stats.count("pruned_control_loop", pruned_control_loop);
+    stats.count("pruned_states", pruned_states);
+    stats.count("fsms", result.size());
+
     return result;
 }
 
+Graph::ConstantKey Graph::constant_key(const Node *node, uint32_t width) {
+    auto const *literal = node->wide_value.get();
+    return {node->value_key(), width, literal && literal->has_unknown()};
+}
+
+Node *Graph::add_constant(int64_t value, uint32_t width, const Literal *wide_value) {
+    // literals that fit are stored as plain values so that they share a node with them
+    if (wide_value && wide_value->fits_int64()) wide_value = nullptr;
+    if (constant_pool_) {
+        auto it = constants_.find({{value, wide_value}, width,
+                                   wide_value && wide_value->has_unknown()});
+        if (it != constants_.end()) return it->second;
+    }
+    auto node = add_node(get_free_id(), "", NodeType::Constant);
+    node->value = value;
+    if (wide_value) node->wide_value = std::make_unique<Literal>(*wide_value);
+    // the key has to point to the literal owned by the node
+    if (constant_pool_) constants_.emplace(constant_key(node, width), node);
+    return node;
+}
+
+Node *Graph::unique_constant(Node *node) {
+    // named constants and parameters are never pooled
+    if (!constant_pool_ || node->type != NodeType::Constant || !node->name.empty()) return node;
+    return copy_node(node, false);
+}
+
+void Graph::label_hierarchy() {
+    // children is not populated for every node, e.g. control nodes, so the tree is built from
+    // the parent links. hierarchy_pre temporarily holds the node index
+    auto num_nodes = nodes_.size();
+    for (uint64_t i = 0; i < num_nodes; i++) nodes_[i]->hierarchy_pre = i;
+    auto parent_index = [&](const Node *node) -> uint64_t {
+        auto const *parent = node->parent;
+        if (!parent) return num_nodes;
+        auto index = parent->hierarchy_pre;
+        // the parent might not belong to this graph
+        return index < num_nodes && nodes_[index].get() == parent ? index : num_nodes + 1;
+    };
+
+    // children of node i are children[offsets[i]:offsets[i + 1]]
+    std::vector<uint64_t> offsets(num_nodes + 1, 0);
+    std::vector<uint64_t> parents(num_nodes);
+    for (uint64_t i = 0; i < num_nodes; i++) {
+        parents[i] = parent_index(nodes_[i].get());
+        if (parents[i] < num_nodes) offsets[parents[i] + 1]++;
+    }
+    for (uint64_t i = 0; i < num_nodes; i++) offsets[i + 1] += offsets[i];
+    std::vector<uint64_t> children(offsets[num_nodes]);
+    std::vector<uint64_t> roots;
+    auto next = offsets;
+    for (uint64_t i = 0; i < num_nodes; i++) {
+        if (parents[i] < num_nodes) {
+            children[next[parents[i]]++] = i;
+        } else if (parents[i] == num_nodes) {
+            roots.emplace_back(i);
+        }
+        nodes_[i]->hierarchy_pre = 0;
+        nodes_[i]->hierarchy_post = 0;
+    }
+
+    // labels start from 1 since 0 means unlabelled. nodes that can't be reached from a root,
+    // e.g. in a parent loop, stay unlabelled
+    uint64_t count = 1;
+    std::vector<std::pair<uint64_t, uint64_t>> stack;
+    for (auto root : roots) {
+        nodes_[root]->hierarchy_pre = count++;
+        stack.emplace_back(root, offsets[root]);
+        while (!stack.empty()) {
+            auto &[index, pos] = stack.back();
+            if (pos < offsets[index + 1]) {
+                auto child = children[pos++];
+                nodes_[child]->hierarchy_pre = count++;
+                stack.emplace_back(child, offsets[child]);
+            } else {
+                nodes_[index]->hierarchy_post = count++;
+                stack.pop_back();
+            }
+        }
+    }
+}
+
 Node *Graph::copy_node(const Node *node, bool copy_connection) {
     auto n = add_node(get_free_id(), node->name);
     n->type = node->type;
     n->value = node->value;
+    if (node->wide_value) n->wide_value = std::make_unique<Literal>(*node->wide_value);
 
     if (copy_connection) {
         // copy the connections as well, if specified
@@ -654,24 +1219,317 @@ Node *Graph::copy_node(const Node *node, bool copy_connection) {
     return n;
 }
 
-std::pair<const Node *, const Node *> coupled_fsms(const Node *fsm_from, const Node *fsm_to,
-                                                   bool fast_mode) {
-    bool coupled = false;
-    if (fast_mode) {
-        coupled = Graph::reachable(fsm_from, fsm_to);
-    } else {
-        reachable_control_loop(fsm_from, fsm_to);
-    }
-    if (coupled) {
+std::pair<const Node *, const Node *> coupled_fsms(const Node *fsm_from, const Node *fsm_to) {
+    // fast mode is answered by ReachabilityEngine in group_fsms
+    if (reachable_control_loop(fsm_from, fsm_to)) {
         return {fsm_from, fsm_to};
     } else {
         return {nullptr, nullptr};
     }
 }
 
+bool is_pass_through(const Node *node) {
+    // anonymous net without any operator that forwards a single value
+    if (node->type != NodeType::Net || node->op != NetOpType::Ignore || !node->name.empty())
+        return false;
+    auto const &info = node->info();
+    if (!info.children.empty() || !info.members.empty() || info.module_def) return false;
+    if (node->edges_from.size() != 1 || node->edges_to.size() != 1) return false;
+    auto const edge_in = *node->edges_from.begin();
+    auto const edge_out = node->edges_to.front().get();
+    if (edge_in->type != EdgeType::Blocking || edge_out->type != EdgeType::Blocking) return false;
+    auto const prev = edge_in->from;
+    auto const next = edge_out->to;
+    if (prev == node || next == node) return false;
+    // extract_fsm_arcs uses the node right after a comparison as the condition
+    if (prev->op == NetOpType::Equal) return false;
+    // anonymous nets block the constant driver and assign chain search. as long as the net
+    // feeds a condition or another anonymous net, removing it won't change any result
+    return next->type == NodeType::Control ||
+           (next->type == NodeType::Net && next->op == NetOpType::Ignore && next->name.empty());
+}
+
+void Graph::partition_edges() {
+    auto edge_class = [](const std::unique_ptr<Edge> &edge) {
+        auto type = static_cast<uint32_t>(edge->type);
+        if (type & CONTROL_EDGES) return 2u;
+        if (type & SLICE_EDGES) return 1u;
+        return 0u;
+    };
+    auto by_class = [&](const std::unique_ptr<Edge> &a, const std::unique_ptr<Edge> &b) {
+        return edge_class(a) < edge_class(b);
+    };
+    for (auto const &node : nodes_) {
+        auto &edges = node->edges_to;
+        // most nodes only have one class, so avoid the buffer stable_sort allocates
+        if (!std::is_sorted(edges.begin(), edges.end(), by_class)) {
+            std::stable_sort(edges.begin(), edges.end(), by_class);
+        }
+        auto slice = std::partition_point(edges.begin(), edges.end(),
+                                          [&](auto const &edge) { return edge_class(edge) < 1; });
+        auto control = std::partition_point(slice, edges.end(),
+                                            [&](auto const &edge) { return edge_class(edge) < 2; });
+        node->slice_edges_begin = static_cast<uint32_t>(slice - edges.begin());
+        node->control_edges_begin = static_cast<uint32_t>(control - edges.begin());
+    }
+}
+
+CompactionStats Graph::compact() {
+    CompactionStats stats;
+    stats.nodes_before = nodes_.size();
+    stats.edges_before = num_edges();
+
+    std::unordered_set<const Node *> removed;
+    for (auto const &ptr : nodes_) {
+        auto node = ptr.get();
+        if (!is_pass_through(node)) continue;
+        // reuse the incoming edge so that the edge order of the predecessor is kept
+        auto edge_in = *node->edges_from.begin();
+        auto edge_out = node->edges_to.front().get();
+        auto next = edge_out->to;
+        next->edges_from.erase(edge_out);
+        next->edges_from.emplace(edge_in);
+        edge_in->to = next;
+        node->edges_from.clear();
+        node->edges_to.clear();
+        if (node->parent && node->parent->has_info()) {
+            auto &siblings = node->parent->mutable_info().children;
+            siblings.erase(std::remove(siblings.begin(), siblings.end(), node), siblings.end());
+        }
+        removed.emplace(node);
+    }
+
+    if (!removed.empty()) {
+        for (auto it = nodes_map_.begin(); it != nodes_map_.end();) {
+            if (removed.find(it->second) != removed.end()) {
+                it = nodes_map_.erase(it);
+            } else {
+                it++;
+            }
+        }
+        nodes_.erase(std::remove_if(nodes_.begin(), nodes_.end(),
+                                    [&removed](auto const &n) {
+                                        return removed.find(n.get()) != removed.end();
+                                    }),
+                     nodes_.end());
+        cache_nodes_.clear();
+        // node indices have changed
+        num_classified_nodes_ = 0;
+        touched_nodes_.clear();
+    }
+
+    stats.nodes_after = nodes_.size();
+    stats.edges_after = num_edges();
+    return stats;
+}
+
+std::unique_ptr<Graph> Graph::slice(const Node *top) const {
+    std::unordered_set<const Node *> nodes;
+    std::vector<const Node *> working_set;
+    auto visit = [&](const Node *node) {
+        if (nodes.emplace(node).second) working_set.emplace_back(node);
+    };
+    // sub-hierarchy
+    visit(top);
+    while (!working_set.empty()) {
+        auto node = working_set.back();
+        working_set.pop_back();
+        for (auto const child : node->info().children) visit(child);
+        for (auto const &iter : node->info().members) visit(iter.second);
+    }
+    // cone of influence. since it's closed under fan-in, any path between two nodes in the slice
+    // stays inside the slice
+    working_set.assign(nodes.begin(), nodes.end());
+    while (!working_set.empty()) {
+        auto node = working_set.back();
+        working_set.pop_back();
+        for (auto const edge : node->edges_from) visit(edge->from);
+        for (auto const &iter : node->info().members) visit(iter.second);
+    }
+    // only need the names from the ancestors
+    std::vector<const Node *> ancestors;
+    for (auto const node : nodes) {
+        for (auto p = node->parent; p && nodes.find(p) == nodes.end(); p = p->parent) {
+            ancestors.emplace_back(p);
+        }
+    }
+    nodes.insert(ancestors.begin(), ancestors.end());
+
+    auto result = std::make_unique<Graph>();
+    std::unordered_map<const Node *, Node *> mapping;
+    std::vector<std::pair<const Node *, Node *>> copies;
+    mapping.reserve(nodes.size());
+    copies.reserve(nodes.size());
+    result->nodes_.reserve(nodes.size());
+    // keep the node order
+    for (auto const &ptr : nodes_) {
+        auto const node = ptr.get();
+        if (nodes.find(node) == nodes.end()) continue;
+        auto n = std::make_unique<Node>(node->id, node->name, node->type);
+        n->op = node->op;
+        n->value = node->value;
+        if (node->wide_value) n->wide_value = std::make_unique<Literal>(*node->wide_value);
+        if (node->has_info()) {
+            auto const &from = node->info();
+            auto &info = n->mutable_info();
+            info.wire_type = from.wire_type;
+            info.port_type = from.port_type;
+            info.event_type = from.event_type;
+            info.num_gen_block = from.num_gen_block;
+        }
+        mapping.emplace(node, n.get());
+        copies.emplace_back(node, n.get());
+        result->nodes_.emplace_back(std::move(n));
+    }
+    auto map_node = [&mapping](const Node *node) -> Node * {
+        auto it = mapping.find(node);
+        return it == mapping.end() ? nullptr : it->second;
+    };
+
+    for (auto const &[node, n] : copies) {
+        n->parent = node->parent ? map_node(node->parent) : nullptr;
+        if (node->has_info()) {
+            auto const &from = node->info();
+            auto &info = n->mutable_info();
+            for (auto const child : from.children) {
+                auto c = map_node(child);
+                if (c) info.children.emplace_back(c);
+            }
+            for (auto const &[member_name, member] : from.members) {
+                info.members.emplace(member_name, map_node(member));
+            }
+            if (from.module_def) {
+                info.module_def = std::make_unique<ModuleDefInfo>();
+                info.module_def->name = from.module_def->name;
+                for (auto const &[param_name, param] : from.module_def->params) {
+                    auto p = map_node(param);
+                    if (p) info.module_def->params.emplace(param_name, p);
+                }
+            }
+        }
+        for (auto const &edge : node->edges_to) {
+            auto to = map_node(edge->to);
+            if (to) n->add_edge(to, edge->type);
+        }
+    }
+
+    for (auto const &[key, node] : nodes_map_) {
+        auto n = map_node(node);
+        if (n) result->nodes_map_.emplace(key, n);
+    }
+    for (auto const &[key, node] : constants_) {
+        auto n = map_node(node);
+        if (n) result->constants_.emplace(constant_key(n, key.width), n);
+    }
+    result->constant_pool_ = constant_pool_;
+    result->free_id_ptr_ = free_id_ptr_;
+
+    return result;
+}
+
+uint64_t Graph::num_edges() const {
+    uint64_t result = 0;
+    for (auto const &node : nodes_) result += node->edges_to.size();
+    return result;
+}
+
+uint64_t GraphMemoryStats::total() const {
+    return nodes + node_infos + names + wire_types + members + children + module_defs +
+           wide_values + edges + edges_from + hash_tables;
+}
+
+// heap bytes of a string. short strings are stored inline
+uint64_t heap_bytes(const std::string &str) {
+    return str.capacity() > std::string().capacity() ? str.capacity() + 1 : 0;
+}
+
+template <typename T>
+uint64_t heap_bytes(const std::vector<T> &vector) {
+    return vector.capacity() * sizeof(T);
+}
+
+// buckets plus one singly-linked node per entry. a table with a single bucket doesn't allocate
+template <typename Table>
+uint64_t heap_bytes_table(const Table &table) {
+    uint64_t buckets = table.bucket_count() > 1 ? table.bucket_count() * sizeof(void *) : 0;
+    return buckets + table.size() * (sizeof(void *) + sizeof(typename Table::value_type));
+}
+
+uint64_t log2_bucket(uint64_t size) {
+    uint64_t bucket = 0;
+    while (size) {
+        size >>= 1u;
+        bucket++;
+    }
+    return bucket;
+}
+
+void add_to_histogram(std::vector<uint64_t> &histogram, uint64_t size) {
+    auto bucket = log2_bucket(size);
+    if (histogram.size() <= bucket) histogram.resize(bucket + 1, 0);
+    histogram[bucket]++;
+}
+
+GraphStats Graph::stats() const {
+    GraphStats result;
+    auto &memory = result.memory;
+    result.num_nodes = nodes_.size();
+    memory.nodes = heap_bytes(nodes_) + nodes_.size() * sizeof(Node);
+    for (auto const &node : nodes_) {
+        result.node_types[node->type]++;
+        auto fan_in = node->edges_from.size();
+        auto fan_out = node->edges_to.size();
+        result.num_edges += fan_out;
+        add_to_histogram(result.fan_in, fan_in);
+        add_to_histogram(result.fan_out, fan_out);
+        result.max_fan_in = std::max<uint64_t>(result.max_fan_in, fan_in);
+        result.max_fan_out = std::max<uint64_t>(result.max_fan_out, fan_out);
+        for (auto const &edge : node->edges_to) result.edge_types[edge->type]++;
+
+        memory.names += heap_bytes(node->name);
+        if (node->has_info()) memory.node_infos += sizeof(NodeInfo);
+        auto const &info = node->info();
+        memory.wire_types += heap_bytes(info.wire_type);
+        memory.members += heap_bytes_table(info.members);
+        for (auto const &iter : info.members) memory.members += heap_bytes(iter.first);
+        memory.children += heap_bytes(info.children);
+        if (info.module_def) {
+            auto const &def = *info.module_def;
+            memory.module_defs +=
+                sizeof(ModuleDefInfo) + heap_bytes(def.name) + heap_bytes_table(def.params);
+            for (auto const &iter : def.params) memory.module_defs += heap_bytes(iter.first);
+        }
+        if (node->wide_value) {
+            auto num_words = node->wide_value->num_words();
+            memory.wide_values +=
+                sizeof(Literal) + (num_words > 1 ? num_words * sizeof(uint64_t) : 0);
+        }
+        memory.edges += heap_bytes(node->edges_to) + fan_out * sizeof(Edge);
+        memory.edges_from += heap_bytes_table(node->edges_from);
+    }
+    memory.hash_tables = heap_bytes_table(nodes_map_) + heap_bytes_table(constants_) +
+                         heap_bytes(cache_nodes_) + heap_bytes(touched_nodes_);
+    return result;
+}
+
 std::unordered_map<const Node *, std::unordered_set<const Node *>> Graph::group_fsms(
     const std::vector<FSMResult> &fsms, bool fast_mode) {
     std::unordered_map<const Node *, std::unordered_set<const Node *>> result;
+    if (fast_mode) {
+        // one bit-parallel search per 64 FSMs instead of one search per pair
+        std::vector<const Node *> nodes;
+        nodes.reserve(fsms.size());
+        for (auto const &fsm : fsms) nodes.emplace_back(fsm.node());
+        ReachabilityEngine engine;
+        auto coupled = engine.reachable(nodes, nodes);
+        for (uint64_t i = 0; i < nodes.size(); i++) {
+            for (uint64_t j = 0; j < nodes.size(); j++) {
+                if (i != j && coupled[i][j]) result[nodes[i]].emplace(nodes[j]);
+            }
+        }
+        return result;
+    }
+
     auto num_cpus = get_num_cpus();
     cxxpool::thread_pool pool{num_cpus};
     std::vector<std::future<std::pair<const Node *, const Node *>>> tasks;
@@ -687,12 +1545,15 @@ std::unordered_map<const Node *, std::unordered_set<const Node *>> Graph::group_
             if (i == j) continue;
             auto const &fsm_to = fsms[j].node();
             auto t = pool.push([=, &mutex, &count, &bar]() {
+                ScopedTrace trace("group_fsms", "fsm_pair", fsm_from, fsm_to);
+                ScopedTrace wait("wait", "mutex");
                 mutex.lock();
+                wait.stop();
                 count++;
                 bar.progress(count, max_fsm);
                 mutex.unlock();
 
-                return coupled_fsms(fsm_from, fsm_to, fast_mode);
+                return coupled_fsms(fsm_from, fsm_to);
             });
             tasks.emplace_back(std::move(t));
         }
@@ -1,12 +1,18 @@
 #ifndef PASTAFARIAN_GRAPH_HH
 #define PASTAFARIAN_GRAPH_HH
 
+#include <algorithm>
 #include <functional>
+#include <limits>
+#include <map>
 #include <memory>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 #include <string>
+#include <type_traits>
+
+#include "literal.hh"
 
 namespace fsm {
 
@@ -59,54 +65,90 @@ inline EdgeType operator&(EdgeType a, EdgeType b) {
     return static_cast<EdgeType>(static_cast<uint32_t>(a) & static_cast<uint32_t>(b));
 }
 
+// flags are joined with |, e.g. Register|Variable
+std::string to_string(NodeType type);
+std::string to_string(EdgeType type);
+
 struct Node;
 struct Edge;
 class FSMResult;
 
+// value of a constant node that can be used as a set/map key. constants wider than 64 bits
+// are compared by their full value
+struct ConstantValue {
+    int64_t value;
+    const Literal* wide_value;
+
+    bool operator==(const ConstantValue& other) const;
+    bool operator<(const ConstantValue& other) const;
+};
+
+struct ConstantValueHash {
+    std::size_t operator()(const ConstantValue& v) const;
+};
+
 struct ModuleDefInfo {
     std::string name;
     std::unordered_map<std::string, const Node*> params;
 };
 
-struct Node {
-public:
-    uint64_t id;
-    std::string name;
-    NodeType type = NodeType::Net;
-
-    std::vector<std::unique_ptr<Edge>> edges_to;
-    std::unordered_set<Edge*> edges_from;
-
-    Node* parent = nullptr;
-    std::vector<Node*> children;
-
-    // by default we don't care. only needed if it's a net and uses certain op
-    NetOpType op = NetOpType::Ignore;
-
-    // only used when it's a constant node
-    int64_t value = 0;
-
+// per-node data that the analyses rarely look at. it lives outside of Node so that traversals
+// only pull the hot fields into cache, and most nodes, e.g. nets and assignments, never have any
+struct NodeInfo {
     // for any wires/regs
     std::string wire_type;
     // only for the ports. other nodes will have none
     PortType port_type = PortType::None;
     EventType event_type = EventType::None;
+    // for module
+    // number of unnamed gen block
+    uint32_t num_gen_block = 0;
     // only for module instances
     std::unique_ptr<ModuleDefInfo> module_def;
     // member access
     // for interface and packed struct
     std::unordered_map<std::string, Node*> members;
-    // for module
-    // number of unnamed gen block
-    uint32_t num_gen_block = 0;
+    std::vector<Node*> children;
+};
+
+struct Node {
+public:
+    // the fields used by the traversals come first
+    uint64_t id;
+    NodeType type = NodeType::Net;
+    // by default we don't care. only needed if it's a net and uses certain op
+    NetOpType op = NetOpType::Ignore;
+    Node* parent = nullptr;
+    // only used when it's a constant node
+    int64_t value = 0;
+
+    std::vector<std::unique_ptr<Edge>> edges_to;
+    std::unordered_set<Edge*> edges_from;
+
+    // DFS entry/exit numbers over the parent links, set by Graph::label_hierarchy(). 0 means the
+    // node is not labelled and child_of() walks the parent chain instead
+    uint64_t hierarchy_pre = 0;
+    uint64_t hierarchy_post = 0;
+
+    // set by Graph::partition_edges(): edges_to is then ordered by edge class, assign | slice |
+    // control, and these are where the slice and control segments start. adding an edge undoes it
+    static constexpr uint32_t UNPARTITIONED = std::numeric_limits<uint32_t>::max();
+    uint32_t slice_edges_begin = 0;
+    uint32_t control_edges_begin = UNPARTITIONED;
+
+    // only set when the constant doesn't fit into value
+    std::unique_ptr<Literal> wide_value;
+    // stays in the node since whether a node is named is checked along every traversal, e.g. by
+    // is_register, the constant driver search, and the pass-through check in compact()
+    std::string name;
 
     Node(uint64_t id, std::string name) : id(id), name(std::move(name)) {}
     Node(uint64_t id, std::string name, Node* parent)
-        : id(id), name(std::move(name)), parent(parent) {}
+        : id(id), parent(parent), name(std::move(name)) {}
     Node(uint64_t id, std::string name, NodeType type)
-        : id(id), name(std::move(name)), type(type) {}
+        : id(id), type(type), name(std::move(name)) {}
     Node(uint64_t id, std::string name, NodeType type, Node* parent)
-        : id(id), name(std::move(name)), type(type), parent(parent) {}
+        : id(id), type(type), parent(parent), name(std::move(name)) {}
     template <typename... Args>
     void update(const std::string& n, Args... args) {
         name = n;
@@ -130,16 +172,27 @@ public:
         auto e = edge.get();
         edges_to.emplace_back(std::move(edge)).get();
         to->edges_from.emplace(e);
+        control_edges_begin = UNPARTITIONED;
         return e;
     }
 
     inline bool has_type(NodeType t) const { return static_cast<bool>(t & type); }
+    [[nodiscard]] bool edges_partitioned() const { return control_edges_begin != UNPARTITIONED; }
 
     [[nodiscard]] std::string handle_name() const;
     [[nodiscard]] std::string handle_name(const Node* parent) const;
     bool child_of(const Node* node) const;
+    [[nodiscard]] ConstantValue value_key() const { return {value, wide_value.get()}; }
+    [[nodiscard]] std::string value_str() const;
+
+    // cold data. reading doesn't allocate, nodes without any share an empty instance
+    [[nodiscard]] const NodeInfo& info() const;
+    NodeInfo& mutable_info();
+    [[nodiscard]] bool has_info() const { return info_ != nullptr; }
 
 private:
+    std::unique_ptr<NodeInfo> info_;
+
     static void update() {}
     struct sink {
         template <typename... Args>
@@ -162,6 +215,142 @@ public:
     }
 };
 
+struct CompactionStats {
+    uint64_t nodes_before = 0;
+    uint64_t nodes_after = 0;
+    uint64_t edges_before = 0;
+    uint64_t edges_after = 0;
+};
+
+// approximate bytes used by the graph, including the inline part of each member. allocator
+// overhead is not included
+struct GraphMemoryStats {
+    // Node objects, their unique_ptr slots, and the members not listed below
+    uint64_t nodes = 0;
+    // NodeInfo objects, for the nodes that have one
+    uint64_t node_infos = 0;
+    uint64_t names = 0;
+    uint64_t wire_types = 0;
+    uint64_t members = 0;
+    uint64_t children = 0;
+    uint64_t module_defs = 0;
+    uint64_t wide_values = 0;
+    // Edge objects and the edges_to vectors
+    uint64_t edges = 0;
+    // edges_from hash sets
+    uint64_t edges_from = 0;
+    // id -> node map, constant pool, and other tables owned by the graph
+    uint64_t hash_tables = 0;
+
+    [[nodiscard]] uint64_t total() const;
+};
+
+struct GraphStats {
+    uint64_t num_nodes = 0;
+    uint64_t num_edges = 0;
+    std::map<NodeType, uint64_t> node_types;
+    std::map<EdgeType, uint64_t> edge_types;
+    // log2 histograms. bucket 0 counts the nodes without any edge, bucket i > 0 the ones with
+    // [2^(i-1), 2^i) edges
+    std::vector<uint64_t> fan_in;
+    std::vector<uint64_t> fan_out;
+    uint64_t max_fan_in = 0;
+    uint64_t max_fan_out = 0;
+    GraphMemoryStats memory;
+};
+
+// traversal kernels. the visitor is a template parameter so that it is inlined into the loop,
+// which matters since it runs on every edge. it returns what to do with edge->to
+enum class Step { Skip, Follow, Stop };
+
+// edge types to skip as a compile-time mask, e.g. edge_mask(EdgeType::Control). skipped edges are
+// not passed to the visitor
+constexpr uint32_t edge_mask(EdgeType type) { return static_cast<uint32_t>(type); }
+
+// every assign edge is either blocking or non-blocking, and every control edge, including the
+// true/false ones, has the control bit
+constexpr uint32_t ASSIGN_EDGES = edge_mask(EdgeType::Blocking) | edge_mask(EdgeType::NonBlocking);
+constexpr uint32_t SLICE_EDGES = edge_mask(EdgeType::Slice);
+constexpr uint32_t CONTROL_EDGES = edge_mask(EdgeType::Control);
+
+// calls f on every out-edge whose type has none of the bits in SkipEdges, until f returns false.
+// returns false if f did. once the node is partitioned, the edge classes that are skipped
+// entirely are not touched at all
+template <uint32_t SkipEdges = 0, typename F>
+bool for_each_edge_to(const Node* node, F&& f) {
+    auto const& edges = node->edges_to;
+    auto visit = [&](uint64_t begin, uint64_t end) {
+        for (auto i = begin; i < end; i++) {
+            auto edge = static_cast<const Edge*>(edges[i].get());
+            if constexpr (SkipEdges != 0) {
+                if (static_cast<uint32_t>(edge->type) & SkipEdges) continue;
+            }
+            if (!f(edge)) return false;
+        }
+        return true;
+    };
+    if constexpr (SkipEdges == 0) {
+        return visit(0, edges.size());
+    } else {
+        if (!node->edges_partitioned()) return visit(0, edges.size());
+        if constexpr ((SkipEdges & ASSIGN_EDGES) != ASSIGN_EDGES) {
+            if (!visit(0, node->slice_edges_begin)) return false;
+        }
+        if constexpr ((SkipEdges & SLICE_EDGES) == 0) {
+            if (!visit(node->slice_edges_begin, node->control_edges_begin)) return false;
+        }
+        if constexpr ((SkipEdges & CONTROL_EDGES) == 0) {
+            if (!visit(node->control_edges_begin, edges.size())) return false;
+        }
+        return true;
+    }
+}
+
+template <typename F>
+using if_edge_predicate = std::enable_if_t<std::is_invocable_r_v<bool, F, const Edge*>>;
+
+// every reachable node is expanded at most once, in breadth-first order. returns true if the
+// visitor stopped the search
+template <uint32_t SkipEdges = 0, typename Visitor>
+bool breadth_first(const Node* from, Visitor&& visit) {
+    std::vector<const Node*> queue = {from};
+    std::unordered_set<const Node*> visited = {from};
+    for (uint64_t head = 0; head < queue.size(); head++) {
+        bool done = !for_each_edge_to<SkipEdges>(queue[head], [&](const Edge* edge) {
+            auto step = visit(edge);
+            if (step == Step::Stop) return false;
+            if (step == Step::Follow && visited.emplace(edge->to).second) {
+                queue.emplace_back(edge->to);
+            }
+            return true;
+        });
+        if (done) return true;
+    }
+    return false;
+}
+
+// same as breadth_first, in depth-first order
+template <uint32_t SkipEdges = 0, typename Visitor>
+bool depth_first(const Node* from, Visitor&& visit) {
+    std::vector<const Node*> stack = {from};
+    std::unordered_set<const Node*> visited;
+    while (!stack.empty()) {
+        auto node = stack.back();
+        stack.pop_back();
+        if (!visited.emplace(node).second) continue;
+        bool done = !for_each_edge_to<SkipEdges>(node, [&](const Edge* edge) {
+            auto step = visit(edge);
+            if (step == Step::Stop) return false;
+            if (step == Step::Follow && visited.find(edge->to) == visited.end()) {
+                stack.emplace_back(edge->to);
+            }
+            return true;
+        });
+        if (done) return true;
+    }
+    return false;
+}
+
 class Graph {
 public:
     template <typename... Args>
@@ -177,8 +366,10 @@ public:
             nodes_.emplace_back(std::move(ptr)).get();
             nodes_map_.emplace(key, n);
         }
-        if (n->parent) {
-            n->parent->children.emplace_back(n);
+        // control nodes don't open a scope. their children are only reachable through parent, so
+        // the assignments under every if/case don't allocate a NodeInfo for the condition
+        if (n->parent && !n->parent->has_type(NodeType::Control)) {
+            n->parent->mutable_info().children.emplace_back(n);
         }
         return n;
     }
@@ -192,9 +383,17 @@ public:
     static bool has_path(const Node* from, const Node* to, uint64_t max_depth = 1u << 20u);
     static bool has_path(const Node* from, const Node* to,
                          const std::function<bool(const Edge*)>& cond);
+    // lambdas pick the template overloads, which inline the predicate. the std::function ones
+    // forward to them
+    template <typename Cond, typename = if_edge_predicate<Cond>>
+    static bool has_path(const Node* from, const Node* to, Cond cond);
 
     Node* select(const std::string& name);
     void identify_registers();
+    // only reclassify the nodes added since the last call, the nodes they drive, and the ones
+    // marked by touch_node(). use touch_node() when connecting two existing nodes
+    void identify_registers_incremental();
+    void touch_node(Node* node) { touched_nodes_.emplace_back(node); }
     [[nodiscard]] std::vector<Node*> get_registers() const;
     static bool constant_driver(const Node* node);
 
@@ -219,6 +418,17 @@ public:
     static std::vector<const Node*> route(const Node* from, const Node* to,
                                           const std::function<bool(const Edge*)>& predicate,
                                           uint32_t depth = 0);
+    template <typename Predicate, typename = if_edge_predicate<Predicate>>
+    static std::unordered_set<const Edge*> find_connection_cond(const Node* from,
+                                                                Predicate predicate);
+    template <typename Predicate, typename Terminate, typename = if_edge_predicate<Predicate>,
+              typename = if_edge_predicate<Terminate>>
+    static std::unordered_set<const Edge*> find_connection_cond(const Node* from,
+                                                                Predicate predicate,
+                                                                Terminate terminate);
+    template <typename Predicate, typename = if_edge_predicate<Predicate>>
+    static std::vector<const Node*> route(const Node* from, const Node* to, Predicate predicate,
+                                          uint32_t depth = 0);
 
     std::vector<FSMResult> identify_fsms();
     std::vector<FSMResult> identify_fsms(const Node* top);
@@ -227,7 +437,33 @@ public:
 
     uint64_t get_free_id() { return free_id_ptr_--; }
 
+    // anonymous constants. when the constant pool is enabled, constants with the same value and
+    // width share the same node. since a shared node may have many fan-outs, use
+    // unique_constant() before adding any edge into it
+    Node* add_constant(int64_t value, uint32_t width, const Literal* wide_value = nullptr);
+    Node* unique_constant(Node* node);
+    void set_constant_pool(bool enable) { constant_pool_ = enable; }
+    [[nodiscard]] bool constant_pool() const { return constant_pool_; }
+
     Node* copy_node(const Node* node, bool copy_connection = true);
+    // splice out anonymous nets that only forward a value. only nets that the detectors treat as
+    // opaque are removed, so FSM detection results stay the same. has to be called before any
+    // analysis since the removed nodes are freed
+    CompactionStats compact();
+    // copy the hierarchy under top and its cone of influence into a new graph. the ancestors of
+    // top are kept as well so that the hierarchical names don't change
+    [[nodiscard]] std::unique_ptr<Graph> slice(const Node* top) const;
+    [[nodiscard]] uint64_t num_edges() const;
+    // node/edge counts by type, fan-in/fan-out histograms, and memory usage
+    [[nodiscard]] GraphStats stats() const;
+    // number every node in DFS order over the parent links so that Node::child_of() is O(1).
+    // nodes added afterwards are not labelled and still work. has to be called again if the
+    // parent of a labelled node changes
+    void label_hierarchy();
+    // order every edges_to by edge class so that the traversals that skip a class, e.g. control
+    // edges, don't touch it at all. the order within a class is kept. has to be called again after
+    // adding edges, otherwise the nodes that got one fall back to filtering every edge
+    void partition_edges();
     [[nodiscard]] const std::vector<std::unique_ptr<Node>>& nodes() const { return nodes_; }
 
 private:
@@ -237,8 +473,212 @@ private:
     // nodes search for cache
     std::vector<Node*> cache_nodes_;
 
+    // constants with x/z bits always carry their literal, whose mask is part of the value
+    // comparison. has_unknown keeps them apart from known values without looking at the literal
+    struct ConstantKey {
+        ConstantValue value;
+        uint32_t width;
+        bool has_unknown;
+        bool operator==(const ConstantKey& other) const {
+            return width == other.width && has_unknown == other.has_unknown &&
+                   value == other.value;
+        }
+    };
+    struct ConstantKeyHash {
+        std::size_t operator()(const ConstantKey& key) const {
+            return ConstantValueHash()(key.value) ^ (static_cast<std::size_t>(key.width) << 1u) ^
+                   static_cast<std::size_t>(key.has_unknown);
+        }
+    };
+    static ConstantKey constant_key(const Node* node, uint32_t width);
+    // for incremental register identification
+    uint64_t num_classified_nodes_ = 0;
+    std::vector<Node*> touched_nodes_;
+
+    bool constant_pool_ = true;
+    std::unordered_map<ConstantKey, Node*, ConstantKeyHash> constants_;
+
     uint64_t free_id_ptr_ = 0xFFFFFFFFFFFFFFFF;
 };
 
+template <typename Cond, typename>
+bool Graph::has_path(const Node* from, const Node* to, Cond cond) {
+    if (from == to) return true;
+    return depth_first(from, [to, &cond](const Edge* edge) {
+        if (!cond(edge)) return Step::Skip;
+        return edge->to == to ? Step::Stop : Step::Follow;
+    });
+}
+
+template <typename Predicate, typename>
+std::unordered_set<const Edge*> Graph::find_connection_cond(const Node* from,
+                                                            Predicate predicate) {
+    return find_connection_cond(from, predicate, [](const Edge*) { return false; });
+}
+
+template <typename Predicate, typename Terminate, typename, typename>
+std::unordered_set<const Edge*> Graph::find_connection_cond(const Node* from,
+                                                            Predicate predicate,
+                                                            Terminate terminate) {
+    std::unordered_set<const Edge*> result;
+    breadth_first(from, [&](const Edge* edge) {
+        if (predicate(edge)) result.emplace(edge);
+        return terminate(edge) ? Step::Skip : Step::Follow;
+    });
+    return result;
+}
+
+template <typename Predicate, typename>
+std::vector<const Node*> Graph::route(const Node* from, const Node* to, Predicate predicate,
+                                      uint32_t depth) {
+    // breadth-first by level so that the depth doesn't need a map. the last edge of the path
+    // doesn't need to satisfy the predicate
+    std::unordered_map<const Node*, const Node*> trace;
+    std::unordered_set<const Node*> visited = {from};
+    std::vector<const Node*> level = {from}, next;
+    bool found = false;
+    for (uint32_t current_depth = 0; !level.empty() && !found; current_depth++) {
+        if (depth > 0 && current_depth > depth) break;
+        for (auto node : level) {
+            for (auto const& edge : node->edges_to) {
+                auto node_to = edge->to;
+                trace.emplace(node_to, node);
+                if (node_to == to) {
+                    found = true;
+                    break;
+                }
+                if (!predicate(static_cast<const Edge*>(edge.get()))) continue;
+                if (visited.emplace(node_to).second) next.emplace_back(node_to);
+            }
+            if (found) break;
+        }
+        level.swap(next);
+        next.clear();
+    }
+    if (!found) return {};
+    std::vector<const Node*> path;
+    for (auto temp = to; temp != from; temp = trace.at(temp)) {
+        path.emplace_back(temp);
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+// answers many route queries over the same part of the graph. nodes get a dense index the first
+// time they are reached and their fan-in/fan-out is cached together with the predicate result,
+// so repeated queries don't touch any hash map
+class RouteEngine {
+public:
+    using Path = std::vector<const Edge*>;
+    using Query = std::pair<const Node*, const Node*>;
+
+    // same as Graph::route, the predicate has to hold on every edge of the path except the last
+    // one. max_length is the maximum number of edges in a path, 0 means unbounded
+    explicit RouteEngine(std::function<bool(const Edge*)> predicate, uint32_t max_length = 0);
+
+    // bidirectional search. returns a shortest path, or empty if there isn't any
+    Path route(const Node* from, const Node* to);
+    // queries with the same source share one forward search, which is much cheaper than running
+    // them one by one when there are many targets. the path for each target is the one Graph::route
+    // would find, i.e. its last edge is the first one discovered by the breadth-first search
+    std::vector<Path> route(const std::vector<Query>& queries);
+
+private:
+    struct Link {
+        uint32_t node;
+        const Edge* edge;
+        bool allowed;
+    };
+    struct Adjacency {
+        bool cached = false;
+        std::vector<Link> links;
+    };
+
+    std::function<bool(const Edge*)> predicate_;
+    uint32_t max_length_;
+
+    std::unordered_map<const Node*, uint32_t> indices_;
+    std::vector<const Node*> nodes_;
+    std::vector<Adjacency> fan_out_;
+    std::vector<Adjacency> fan_in_;
+
+    // per search state, only valid when the stamp matches the current search
+    uint32_t stamp_ = 0;
+    struct Visit {
+        uint32_t stamp = 0;
+        uint32_t depth = 0;
+        uint32_t parent = 0;
+        const Edge* edge = nullptr;
+    };
+    std::vector<Visit> forward_;
+    std::vector<Visit> backward_;
+    std::vector<uint32_t> target_stamp_;
+
+    uint32_t index(const Node* node);
+    const std::vector<Link>& fan_out(uint32_t index);
+    const std::vector<Link>& fan_in(uint32_t index);
+    void next_search();
+    Path forward_path(uint32_t index) const;
+};
+
+// answers many reachability queries over the same part of the graph. the sources are searched 64
+// at a time with a bit-parallel breadth-first search: every node carries one bit per source in a
+// machine word, and a whole batch is propagated with one sweep, so a batch costs about as much as
+// a single search
+class ReachabilityEngine {
+public:
+    using Query = std::pair<const Node*, const Node*>;
+
+    // same rules as RouteEngine: the predicate has to hold on every edge of the path except the
+    // last one, and max_length is the maximum number of edges in a path, 0 means unbounded. no
+    // predicate means every edge can be followed
+    explicit ReachabilityEngine(std::function<bool(const Edge*)> predicate = nullptr,
+                                uint32_t max_length = 0);
+
+    // whether there is a path of at least one edge from the source to the target of each query.
+    // unlike Graph::reachable, a node only reaches itself through a loop
+    std::vector<bool> reachable(const std::vector<Query>& queries);
+    // every source against every target, i.e. result[i][j] is whether sources[i] reaches
+    // targets[j], without listing all the pairs
+    std::vector<std::vector<bool>> reachable(const std::vector<const Node*>& sources,
+                                             const std::vector<const Node*>& targets);
+
+private:
+    static constexpr uint32_t BATCH_SIZE = 64;
+
+    struct Link {
+        uint32_t node;
+        bool allowed;
+    };
+    struct Adjacency {
+        bool cached = false;
+        std::vector<Link> links;
+    };
+
+    std::function<bool(const Edge*)> predicate_;
+    uint32_t max_length_;
+
+    std::unordered_map<const Node*, uint32_t> indices_;
+    std::vector<const Node*> nodes_;
+    std::vector<Adjacency> fan_out_;
+
+    // one bit per source of the current batch
+    // sources that reached the node through any last edge
+    std::vector<uint64_t> reached_;
+    // sources that already expanded the node
+    std::vector<uint64_t> seen_;
+    // sources that expand the node in the current and the next level
+    std::vector<uint64_t> frontier_;
+    std::vector<uint64_t> next_;
+    // sources that query the node as a target
+    std::vector<uint64_t> wanted_;
+
+    uint32_t index(const Node* node);
+    const std::vector<Link>& fan_out(uint32_t index);
+    // bit i of every word is sources[i]. wanted_ has to be set for the targets, and is cleared
+    // afterwards. the result is in reached_
+    void search(const std::vector<uint32_t>& sources, const std::vector<uint32_t>& targets);
+};
+
 }  // namespace fsm
 #endif  // PASTAFARIAN_GRAPH_HH
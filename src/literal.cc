@@ -0,0 +1,338 @@
+#include "literal.hh"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+
+#include "util.hh"
+
+namespace fsm {
+
+constexpr uint32_t WORD_BITS = 64;
+constexpr int32_t INVALID_DIGIT = -1;
+constexpr int32_t UNKNOWN_DIGIT = -2;
+
+int32_t digit_value(char c, uint32_t base) {
+    if (c == 'x' || c == 'X' || c == 'z' || c == 'Z' || c == '?') return UNKNOWN_DIGIT;
+    uint32_t d;
+    if (c >= '0' && c <= '9') {
+        d = c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        d = c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        d = c - 'A' + 10;
+    } else {
+        return INVALID_DIGIT;
+    }
+    return d < base ? static_cast<int32_t>(d) : INVALID_DIGIT;
+}
+
+// words = words * mul + add. mul and add have to be small, i.e. no more than 16
+void mul_add(std::vector<uint64_t> &words, uint64_t mul, uint64_t add) {
+    uint64_t carry = add;
+    for (auto &w : words) {
+        // split into 32-bit halves so that we don't need 128-bit integers
+        uint64_t lo = (w & 0xFFFFFFFFu) * mul + (carry & 0xFFFFFFFFu);
+        uint64_t hi = (w >> 32u) * mul + (carry >> 32u) + (lo >> 32u);
+        w = (lo & 0xFFFFFFFFu) | (hi << 32u);
+        carry = hi >> 32u;
+    }
+    if (carry) words.emplace_back(carry);
+}
+
+uint32_t bit_length(uint64_t value) {
+    uint32_t length = 0;
+    while (value) {
+        length++;
+        value >>= 1u;
+    }
+    return length;
+}
+
+Literal Literal::parse(std::string_view str) {
+    Literal result;
+    auto const *ptr = str.data();
+    auto const *end = ptr + str.size();
+    auto skip_space = [&]() {
+        while (ptr != end && std::isspace(static_cast<unsigned char>(*ptr))) ptr++;
+    };
+
+    skip_space();
+    bool negative = false;
+    if (ptr != end && (*ptr == '-' || *ptr == '+')) {
+        negative = *ptr == '-';
+        ptr++;
+    }
+
+    uint32_t base = 10;
+    bool unbased = false;
+    auto const *tick = std::find(ptr, end, '\'');
+    if (tick == end) {
+        // plain decimal number is signed
+        result.is_signed_ = true;
+    } else {
+        if (tick != ptr) {
+            uint32_t size = 0;
+            auto [size_end, ec] = std::from_chars(ptr, tick, size);
+            assert_(ec == std::errc() && size > 0, "invalid literal size");
+            ptr = size_end;
+            skip_space();
+            assert_(ptr == tick, "invalid literal size");
+            result.width_ = size;
+            result.is_sized_ = true;
+        }
+        ptr = tick + 1;
+        if (ptr != end && (*ptr == 's' || *ptr == 'S')) {
+            result.is_signed_ = true;
+            ptr++;
+        }
+        assert_(ptr != end, "literal has no digits");
+        switch (*ptr) {
+            case 'b':
+            case 'B':
+                base = 2;
+                ptr++;
+                break;
+            case 'o':
+            case 'O':
+                base = 8;
+                ptr++;
+                break;
+            case 'd':
+            case 'D':
+                base = 10;
+                ptr++;
+                break;
+            case 'h':
+            case 'H':
+                base = 16;
+                ptr++;
+                break;
+            default:
+                // unbased unsized literal, i.e. '0, '1, 'x, and 'z
+                unbased = true;
+                base = 2;
+        }
+        skip_space();
+    }
+
+    result.parse_digits(std::string_view(ptr, end - ptr), base);
+    if (unbased && !result.is_sized_) {
+        result.width_ = 1;
+        result.truncate();
+    }
+    if (negative) result.negate();
+
+    return result;
+}
+
+void Literal::parse_digits(std::string_view digits, uint32_t base) {
+    // if the literal fits into 64 bits, overflow is harmless since the value will be truncated
+    // anyway
+    bool wrap = is_sized_ && width_ <= WORD_BITS;
+    uint64_t value = 0;
+    bool wide = false;
+    uint32_t num_digits = 0;
+    bool leading_unknown = false;
+    // x/z bits of binary, octal, and hex digits, accumulated the same way as the value.
+    // a decimal x/z digit makes the whole literal unknown
+    std::vector<uint64_t> unknown;
+    for (auto const c : digits) {
+        if (c == '_') continue;
+        auto d = digit_value(c, base);
+        // same as stoll, we stop at the first non-digit character
+        if (d == INVALID_DIGIT) break;
+        bool is_unknown = d == UNKNOWN_DIGIT;
+        if (is_unknown) {
+            if (num_digits == 0) leading_unknown = true;
+            if (unknown.empty()) unknown = {0};
+            d = 0;
+        }
+        if (!unknown.empty() && base != 10) {
+            mul_add(unknown, base, is_unknown ? base - 1 : 0);
+            // only the lower bits survive truncation
+            if (wrap && unknown.size() > 1) unknown.resize(1);
+        }
+        num_digits++;
+        auto digit = static_cast<uint64_t>(d);
+        if (wide) {
+            mul_add(words_, base, digit);
+        } else if (wrap || value <= (UINT64_MAX - digit) / base) {
+            value = value * base + digit;
+        } else {
+            wide = true;
+            words_ = {value};
+            mul_add(words_, base, digit);
+        }
+    }
+    assert_(num_digits > 0, "literal has no digits");
+
+    if (!wide) value_ = value;
+    if (!is_sized_) {
+        // unsized literals are at least 32 bits. signed ones need an extra sign bit
+        auto length = wide ? (words_.size() - 1) * WORD_BITS + bit_length(words_.back())
+                           : bit_length(value);
+        if (is_signed_ && length >= width_) length++;
+        width_ = std::max<uint32_t>(width_, length);
+    }
+    unknown_ = std::move(unknown);
+    if (base == 10 && !unknown_.empty()) {
+        set_unknown_from(0);
+    } else if (leading_unknown) {
+        // a leftmost x/z digit is extended to the full width, e.g. 8'bx is 8'bxxxxxxxx
+        auto digit_bits = bit_length(base - 1);
+        set_unknown_from(static_cast<uint64_t>(num_digits) * digit_bits);
+    }
+    truncate();
+}
+
+void Literal::set_unknown_from(uint64_t bit) {
+    unknown_.resize((width_ + WORD_BITS - 1) / WORD_BITS, 0);
+    for (uint64_t i = bit; i < width_; i++) {
+        unknown_[i / WORD_BITS] |= 1ull << (i % WORD_BITS);
+    }
+}
+
+void Literal::truncate() {
+    auto mask = width_ % WORD_BITS ? (1ull << (width_ % WORD_BITS)) - 1 : ~0ull;
+    if (width_ <= WORD_BITS) {
+        if (!words_.empty()) {
+            value_ = words_.front();
+            words_.clear();
+        }
+        value_ &= mask;
+    } else {
+        if (words_.empty()) words_ = {value_};
+        value_ = 0;
+        words_.resize((width_ + WORD_BITS - 1) / WORD_BITS, 0);
+        words_.back() &= mask;
+    }
+    if (!unknown_.empty()) {
+        unknown_.resize(num_words(), 0);
+        unknown_.back() &= mask;
+        if (std::all_of(unknown_.begin(), unknown_.end(), [](auto w) { return w == 0; })) {
+            unknown_.clear();
+        } else if (words_.empty()) {
+            // x/z bits always read as 0 so that the value compares consistently
+            value_ &= ~unknown_.front();
+        } else {
+            for (uint64_t i = 0; i < words_.size(); i++) words_[i] &= ~unknown_[i];
+        }
+    }
+}
+
+void Literal::negate() {
+    // any x/z bit makes the result of an arithmetic operation fully unknown
+    if (!unknown_.empty()) set_unknown_from(0);
+    // two's complement
+    if (words_.empty()) {
+        value_ = ~value_ + 1;
+    } else {
+        uint64_t carry = 1;
+        for (auto &w : words_) {
+            w = ~w + carry;
+            carry = carry && w == 0;
+        }
+    }
+    truncate();
+}
+
+uint64_t Literal::word(uint32_t index) const {
+    if (words_.empty()) return index == 0 ? value_ : 0;
+    return index < words_.size() ? words_[index] : 0;
+}
+
+uint64_t Literal::unknown_word(uint32_t index) const {
+    return index < unknown_.size() ? unknown_[index] : 0;
+}
+
+bool Literal::fits_int64() const {
+    if (!unknown_.empty()) return false;
+    if (width_ <= WORD_BITS) return true;
+    // the upper words have to be sign/zero extension of the lower 64 bits
+    auto fill = is_signed_ && (words_.front() >> (WORD_BITS - 1)) ? ~0ull : 0ull;
+    for (uint64_t i = 1; i < words_.size(); i++) {
+        auto expected = fill;
+        if (i == words_.size() - 1 && width_ % WORD_BITS) {
+            expected &= (1ull << (width_ % WORD_BITS)) - 1;
+        }
+        if (words_[i] != expected) return false;
+    }
+    return true;
+}
+
+int64_t Literal::to_int64() const {
+    auto v = word(0);
+    if (width_ < WORD_BITS && is_signed_ && ((v >> (width_ - 1)) & 1u)) {
+        v |= ~0ull << width_;
+    }
+    return static_cast<int64_t>(v);
+}
+
+std::string Literal::str() const {
+    if (!unknown_.empty()) {
+        // x/z bits can't be expressed in hex in general
+        auto result = fmt::format("{0}'{1}b", width_, is_signed_ ? "s" : "");
+        for (uint32_t i = width_; i > 0; i--) {
+            auto word_index = (i - 1) / WORD_BITS;
+            auto bit = 1ull << ((i - 1) % WORD_BITS);
+            if (unknown_word(word_index) & bit) {
+                result.push_back('x');
+            } else {
+                result.push_back(word(word_index) & bit ? '1' : '0');
+            }
+        }
+        return result;
+    }
+    auto result = fmt::format("{0}'{1}h", width_, is_signed_ ? "s" : "");
+    auto out = std::back_inserter(result);
+    uint32_t top = num_words() - 1;
+    while (top > 0 && word(top) == 0) top--;
+    fmt::format_to(out, "{0:x}", word(top));
+    for (uint32_t i = top; i > 0; i--) {
+        fmt::format_to(out, "{0:016x}", word(i - 1));
+    }
+    return result;
+}
+
+bool Literal::operator==(const Literal &other) const {
+    auto n = std::max(num_words(), other.num_words());
+    for (uint32_t i = 0; i < n; i++) {
+        if (word(i) != other.word(i) || unknown_word(i) != other.unknown_word(i)) return false;
+    }
+    return true;
+}
+
+bool Literal::operator<(const Literal &other) const {
+    auto n = std::max(num_words(), other.num_words());
+    for (uint32_t i = n; i > 0; i--) {
+        auto a = word(i - 1);
+        auto b = other.word(i - 1);
+        if (a != b) return a < b;
+    }
+    // known values are ordered before values with x/z bits
+    for (uint32_t i = n; i > 0; i--) {
+        auto a = unknown_word(i - 1);
+        auto b = other.unknown_word(i - 1);
+        if (a != b) return a < b;
+    }
+    return false;
+}
+
+uint64_t Literal::hash() const {
+    // upper zero words are ignored so that the hash is consistent with operator==
+    uint32_t top = num_words();
+    while (top > 1 && word(top - 1) == 0) top--;
+    uint64_t result = 0;
+    for (uint32_t i = 0; i < top; i++) {
+        result ^= word(i) + 0x9e3779b97f4a7c15ull + (result << 6u) + (result >> 2u);
+    }
+    for (auto const w : unknown_) {
+        result ^= w + 0x9e3779b97f4a7c15ull + (result << 6u) + (result >> 2u);
+    }
+    return result;
+}
+
+}  // namespace fsm
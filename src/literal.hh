@@ -0,0 +1,60 @@
+#ifndef PASTAFARIAN_LITERAL_HH
+#define PASTAFARIAN_LITERAL_HH
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fsm {
+
+// SystemVerilog integer literal with arbitrary width, e.g. 42, 'h3F, '1, 128'sh1_0000_0000.
+// x/z bits are tracked as a mask next to the value, where they read as 0
+class Literal {
+public:
+    Literal() = default;
+
+    static Literal parse(std::string_view str);
+
+    [[nodiscard]] uint32_t width() const { return width_; }
+    [[nodiscard]] bool is_signed() const { return is_signed_; }
+    [[nodiscard]] bool is_sized() const { return is_sized_; }
+    [[nodiscard]] bool has_unknown() const { return !unknown_.empty(); }
+    [[nodiscard]] uint32_t num_words() const { return words_.empty() ? 1 : words_.size(); }
+    // little endian
+    [[nodiscard]] uint64_t word(uint32_t index) const;
+    // x/z bits, little endian
+    [[nodiscard]] uint64_t unknown_word(uint32_t index) const;
+
+    // whether to_int64() preserves the value. never true with x/z bits
+    [[nodiscard]] bool fits_int64() const;
+    // lower 64 bits, sign extended if the literal is signed
+    [[nodiscard]] int64_t to_int64() const;
+    [[nodiscard]] std::string str() const;
+
+    // value comparison including x/z bits, regardless of width and sign
+    bool operator==(const Literal &other) const;
+    bool operator!=(const Literal &other) const { return !(*this == other); }
+    bool operator<(const Literal &other) const;
+    [[nodiscard]] uint64_t hash() const;
+
+private:
+    uint32_t width_ = 32;
+    bool is_signed_ = false;
+    bool is_sized_ = false;
+    // only used when the width is no more than 64 bits, so that most literals don't allocate
+    uint64_t value_ = 0;
+    // only used for wide literals
+    std::vector<uint64_t> words_;
+    // x/z mask with the same number of words as the value. empty if all bits are known
+    std::vector<uint64_t> unknown_;
+
+    void parse_digits(std::string_view digits, uint32_t base);
+    void set_unknown_from(uint64_t bit);
+    void truncate();
+    void negate();
+};
+
+}  // namespace fsm
+
+#endif  // PASTAFARIAN_LITERAL_HH
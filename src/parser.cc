@@ -1,5 +1,8 @@
 #include "parser.hh"
 
+#include <array>
+#include <atomic>
+#include <charconv>
 #include <iostream>
 #include <optional>
 #include <queue>
@@ -62,7 +65,7 @@ void parse_verilog(SourceManager &source) {
 
 template <class T>
 Node *parse_dispatch(T value, Graph *g, Node *parent);
-int64_t parse_num_literal(std::string_view str);
+void set_constant_value(Node *node, std::string_view str);
 
 template <class T>
 Node *parse_real_literal(T value, Graph *g) {
@@ -80,10 +83,7 @@ Node *parse_real_literal(T value, Graph *g) {
         std::cerr << "Unable to parse " << real_str << std::endl;
     }
 
-    auto node = g->add_node(g->get_free_id(), "", NodeType::Constant);
-    node->value = static_cast<int64_t>(real);
-
-    return node;
+    return g->add_constant(static_cast<int64_t>(real), 64);
 }
 
 template <class T>
@@ -94,16 +94,38 @@ uint64_t get_address(T value) {
     return addr;
 }
 
-uint64_t parse_internal_symbol(std::string_view symbol) {
-    auto tokens = string::get_tokens(symbol, " ");
-    assert_(tokens.size() == 2, "internal symbol has to be two tokens");
-    return static_cast<uint64_t>(std::stoll(tokens[0]));
+struct InternalSymbol {
+    uint64_t addr;
+    std::string_view name;
+};
+
+InternalSymbol decode_internal_symbol(std::string_view symbol) {
+    // slang encodes symbol reference as "<addr> <name>". decode both in a single pass
+    auto const *ptr = symbol.data();
+    auto const *end = ptr + symbol.size();
+    auto skip_space = [&]() {
+        while (ptr != end && *ptr == ' ') ptr++;
+    };
+
+    skip_space();
+    int64_t addr = 0;
+    auto [addr_end, ec] = std::from_chars(ptr, end, addr);
+    assert_(ec == std::errc() && addr_end != end && *addr_end == ' ',
+            "invalid internal symbol address");
+    ptr = addr_end;
+    skip_space();
+    auto const *name = ptr;
+    while (ptr != end && *ptr != ' ') ptr++;
+    auto const *name_end = ptr;
+    skip_space();
+    assert_(name != name_end && ptr == end, "internal symbol has to be two tokens");
+
+    return {static_cast<uint64_t>(addr),
+            std::string_view(name, static_cast<uint64_t>(name_end - name))};
 }
 
-std::string parse_internal_symbol_name(std::string_view symbol) {
-    auto tokens = string::get_tokens(symbol, " ");
-    assert_(tokens.size() == 2, "internal symbol has to be two tokens");
-    return tokens[1];
+std::string_view parse_internal_symbol_name(std::string_view symbol) {
+    return decode_internal_symbol(symbol).name;
 }
 
 template <class T>
@@ -111,17 +133,15 @@ Node *parse_named_value(T value, Graph *g) {
     // if it is a constant symbol
     auto constant = value["constant"];
 
-    auto symbol = value["symbol"].as_string().value;
-    auto symbol_addr = parse_internal_symbol(symbol);
+    auto symbol = decode_internal_symbol(value["symbol"].as_string().value);
+    auto symbol_addr = symbol.addr;
 
     if (!g->has_node(symbol_addr) && constant.error == SUCCESS) {
-        auto c = parse_num_literal(constant.as_string().value);
         // this is a named constant
         // use the name for the name so that when we reconstruct the FSM state transition graph
         // the name will be there
-        auto name = parse_internal_symbol_name(symbol);
-        auto node = g->add_node(symbol_addr, name, NodeType::Constant);
-        node->value = c;
+        auto node = g->add_node(symbol_addr, std::string(symbol.name), NodeType::Constant);
+        set_constant_value(node, constant.as_string().value);
         return node;
     } else {
         // if the symbol doesn't exist, the graph will create one
@@ -130,39 +150,19 @@ Node *parse_named_value(T value, Graph *g) {
     }
 }
 
-int64_t parse_num_literal(std::string_view str) {
-    auto tokens = string::get_tokens(str, "'");
-    // we don't care about the size
-    auto name_str = tokens.back();
-    if (name_str[0] == 's') {
-        // don't care about the sign
-        name_str = name_str.substr(1);
-    }
-    uint32_t base;
-    if (name_str[0] == 'b') {
-        base = 2;
-        name_str = name_str.substr(1);
-    } else if (name_str[0] == 'h') {
-        base = 16;
-        name_str = name_str.substr(1);
-    } else if (name_str[0] == 'o') {
-        base = 8;
-        name_str = name_str.substr(1);
-    } else if (name_str[0] == 'd') {
-        base = 10;
-        name_str = name_str.substr(1);
+int64_t get_constant_value(const Literal &literal) {
+    // sized literals keep their bit pattern since the state variables they are compared against
+    // are mostly unsigned. plain decimal numbers, e.g. -1, are sign extended
+    return literal.is_sized() ? static_cast<int64_t>(literal.word(0)) : literal.to_int64();
+}
+
+void set_constant_value(Node *node, std::string_view str) {
+    auto literal = Literal::parse(str);
+    node->value = get_constant_value(literal);
+    if (!literal.fits_int64()) {
+        node->wide_value = std::make_unique<Literal>(std::move(literal));
     } else {
-        base = 10;
-    }
-    if (name_str.find('x') != std::string::npos || name_str.find('z') != std::string::npos) {
-        // don't care for now?
-        return 0;
-    }
-    try {
-        auto r = std::stoll(name_str, nullptr, base);
-        return r;
-    } catch (std::out_of_range &) {
-        return 0xFFFFFFFFFFFFFFFF;
+        node->wide_value = nullptr;
     }
 }
 
@@ -191,18 +191,18 @@ Node *parse_param(T value, Graph *g, Node *parent) {
     auto v_json = value["value"];
     assert_(v_json.error == SUCCESS, "value not found in parameter");
     auto v_str = v_json.as_string();
-    auto v = parse_num_literal(v_str);
 
     auto node = g->add_node(addr, name, NodeType::Constant, parent);
-    node->value = v;
+    set_constant_value(node, v_str);
 
     // non-local module level parameter
     auto is_port_raw = value["isPort"];
     assert_(is_port_raw.error == SUCCESS, "isPort not found in parameter");
     if (is_port_raw.as_bool()) {
         // it's a port parameter, put it to the module definition
-        if (parent->type == NodeType::Module) {
-            parent->module_def->params.emplace(name, node);
+        if (parent && parent->type == NodeType::Module) {
+            auto const &module_def = parent->info().module_def;
+            if (module_def) module_def->params.emplace(name, node);
         }
     }
 
@@ -222,11 +222,13 @@ Node *parse_num_literal(T value, Graph *g) {
         string_literal = true;
     }
     assert_(value_json.error == SUCCESS, "constant value not found in number literal");
-    auto v = string_literal ? parse_string_literal(value_json.as_string())
-                            : parse_num_literal(value_json.as_string());
-    auto node = g->add_node(g->get_free_id(), "", NodeType::Constant);
-    node->value = v;
-    return node;
+    if (string_literal) {
+        std::string_view str = value_json.as_string();
+        return g->add_constant(parse_string_literal(str), str.size() * 8);
+    }
+    auto literal = Literal::parse(value_json.as_string());
+    return g->add_constant(get_constant_value(literal), literal.width(),
+                           literal.fits_int64() ? nullptr : &literal);
 }
 
 template <class T>
@@ -261,12 +263,12 @@ Node *parse_signal_event(T value, Graph *g, Node *parent) {
     assert_(edge_raw.error == SUCCESS, "cannot find edge from signal event");
     auto edge = std::string(edge_raw.as_string());
     if (edge == "PosEdge") {
-        expr->event_type = EventType::Posedge;
+        expr->mutable_info().event_type = EventType::Posedge;
     } else if (edge == "NegEdge") {
-        expr->event_type = EventType::Negedge;
+        expr->mutable_info().event_type = EventType::Negedge;
     } else {
         assert_(edge == "None", "Unknown edge type " + edge);
-        expr->event_type = EventType::None;
+        expr->mutable_info().event_type = EventType::None;
     }
     return nullptr;
 }
@@ -311,8 +313,8 @@ Node *parse_module(T &value, Graph *g, Node *parent) {
     auto definition = value["definition"].as_string();
     auto def_name = parse_internal_symbol_name(definition);
     auto module_def = std::make_unique<ModuleDefInfo>();
-    module_def->name = def_name;
-    n->module_def = std::move(module_def);
+    module_def->name = std::string(def_name);
+    n->mutable_info().module_def = std::move(module_def);
 
     // parse inner members
     if (value["members"].error == SUCCESS) {
@@ -329,12 +331,12 @@ template <class T>
 Node *parse_member_access(T &value, Graph *g) {
     auto field = value["field"];
     assert_(field.error == SUCCESS, "unable to find field from member access");
-    auto field_str = std::string(field.as_string());
-    field_str = parse_internal_symbol_name(field_str);
+    auto field_str = std::string(parse_internal_symbol_name(field.as_string()));
     auto v = value["value"];
     Node *n = parse_dispatch(v, g, nullptr);
-    assert_(n->members.find(field_str) != n->members.end(), "unable to find " + field_str);
-    auto child = n->members.at(field_str);
+    auto const &members = n->info().members;
+    assert_(members.find(field_str) != members.end(), "unable to find " + field_str);
+    auto child = members.at(field_str);
     return child;
 }
 
@@ -431,7 +433,7 @@ Node *parse_range_select(T value, Graph *g) {
     auto v = value["value"];
     auto left = value["left"];
     auto right = value["right"];
-    auto v_node = parse_dispatch(v, g, nullptr);
+    auto v_node = g->unique_constant(parse_dispatch(v, g, nullptr));
     auto left_node = parse_dispatch(left, g, nullptr);
     auto right_node = parse_dispatch(right, g, nullptr);
 
@@ -528,6 +530,7 @@ Node *parse_element_select(T value, Graph *g) {
 
     auto v_node = parse_dispatch(v, g, nullptr);
     assert_(v_node != nullptr, "cannot parse value for element select");
+    v_node = g->unique_constant(v_node);
     auto selector_node = parse_dispatch(selector, g, nullptr);
     assert_(v_node != nullptr, "cannot parse selector for element select");
 
@@ -546,8 +549,10 @@ Node *parse_for_loop(T value, Graph *g, Node *parent) {
 }
 
 bool is_system_task(std::string_view subroutine_name) {
-    auto tokens = string::get_tokens(subroutine_name, " ");
-    return tokens.size() == 1 && tokens[0][0] == '$';
+    auto tokens = string::split(subroutine_name, " ");
+    auto it = tokens.begin();
+    if (it == tokens.end() || (*it)[0] != '$') return false;
+    return ++it == tokens.end();
 }
 
 template <class T>
@@ -558,9 +563,9 @@ Node *parse_call(T value, Graph *g, Node *parent) {
     auto subroutine = value["subroutine"];
     auto subroutine_name = subroutine.as_string();
     if (!is_system_task(subroutine_name)) {
-        auto tokens = string::get_tokens(subroutine_name, " ");
-        auto name = tokens.back();
-        if (checked_subroutines.find(name) == checked_subroutines.end()) {
+        std::string_view name;
+        for (auto const &token : string::split(subroutine_name, " ")) name = token;
+        if (checked_subroutines.find(std::string(name)) == checked_subroutines.end()) {
             std::cerr << "Custom task/function " << name << " not supported" << std::endl;
             checked_subroutines.emplace(name);
         }
@@ -590,6 +595,9 @@ Node *parse_case(T value, Graph *g, Node *parent) {
     auto cond_node = value["expr"];
     assert_(cond_node.error == SUCCESS, "expr not found in case statement");
     auto cond = parse_dispatch(cond_node, g, parent);
+    assert_(cond != nullptr, "cannot parse expr in case statement");
+    // case (1'b1) adds a control edge into the constant
+    cond = g->unique_constant(cond);
 
     auto const &item_array = items.as_array();
     for (auto const &item : item_array) {
@@ -669,15 +677,15 @@ Node *parse_assignment(T value, Graph *g, Node *parent) {
         // right is just the parent
         right_node = parent;
     }
-    if (right_node->members.empty()) {
+    if (right_node->info().members.empty()) {
         add_assignment_node(value, g, parent, addr, left_node, right_node);
     } else {
-        assert_(right_node->members.size() == left_node->members.size(),
+        assert_(right_node->info().members.size() == left_node->info().members.size(),
                 "only packed struct to packed struct allowed");
-        for (auto const &[var_name, node_l] : left_node->members) {
-            assert_(right_node->members.find(var_name) != right_node->members.end(),
+        for (auto const &[var_name, node_l] : left_node->info().members) {
+            assert_(right_node->info().members.find(var_name) != right_node->info().members.end(),
                     ::format("unable to find {0} form {1}", var_name, right_node->name));
-            auto node_r = right_node->members.at(var_name);
+            auto node_r = right_node->info().members.at(var_name);
             add_assignment_node(value, g, parent, addr, node_l, node_r);
         }
     }
@@ -718,7 +726,7 @@ Node *parse_genvar(T value, Graph *g, Node *parent) {
     auto name = value["name"];
     auto name_str = std::string(name.as_string());
     auto node = g->add_node(g->get_free_id(), name_str);
-    parent->members.emplace(name_str, node);
+    parent->mutable_info().members.emplace(name_str, node);
 
     return node;
 }
@@ -737,7 +745,7 @@ Node *parse_generated_block_array(T value, Graph *g, Node *parent) {
         // search for genblock
         assert_(parent->type == NodeType::Module, "genblock parent has to be a module");
         // FIXME: we assume there is no variable called genblk
-        auto n_gen = ++parent->num_gen_block;
+        auto n_gen = ++parent->mutable_info().num_gen_block;
         name_str = ::format("genblk{0}", n_gen);
     }
 
@@ -756,7 +764,7 @@ Node *parse_generated_block_array(T value, Graph *g, Node *parent) {
                 auto name_ = std::string(name_raw_);
                 // find members
                 auto param = parse_param(member_, g, nullptr);
-                if (parent->members.find(name_) != parent->members.end()) {
+                if (parent->info().members.find(name_) != parent->info().members.end()) {
                     index = param->value;
                     break;
                 } else {
@@ -773,7 +781,7 @@ Node *parse_generated_block_array(T value, Graph *g, Node *parent) {
         } else {
             auto module_name = ::format("{0}[{1}]", name_str, *index);
             auto module = g->add_node(g->get_free_id(), module_name, NodeType::Module);
-            parent->children.emplace_back(module);
+            parent->mutable_info().children.emplace_back(module);
             module->parent = parent;
 
             // parse the member
@@ -848,10 +856,10 @@ void parse_struct_str(const std::string &string, Node *root, Graph *g) {
         auto g_n = node_map.at(p_n);
         for (auto const c_n : p_n->children) {
             assert_(!c_n->name.empty(), "member name empty");
-            if (g_n->members.find(c_n->name) != g_n->members.end()) continue;
+            if (g_n->info().members.find(c_n->name) != g_n->info().members.end()) continue;
             auto new_node = g->add_node(g->get_free_id(), c_n->name);
-            g_n->members.emplace(new_node->name, new_node);
-            g_n->children.emplace_back(new_node);
+            g_n->mutable_info().members.emplace(new_node->name, new_node);
+            g_n->mutable_info().children.emplace_back(new_node);
             new_node->parent = g_n;
             node_map.emplace(c_n, new_node);
 
@@ -912,8 +920,8 @@ Node *parse_net(T value, Graph *g, Node *parent) {
                 }
             }
         } else if (elem.is_string()) {
-            n->wire_type = wire_str;
-            if (n->wire_type.find('$') != std::string::npos) {
+            n->mutable_info().wire_type = wire_str;
+            if (n->info().wire_type.find('$') != std::string::npos) {
                 complex_struct = true;
             }
         }
@@ -922,9 +930,8 @@ Node *parse_net(T value, Graph *g, Node *parent) {
         }
     }
     if (value["internalSymbol"].error == SUCCESS) {
-        auto symbol = value["internalSymbol"].as_string();
-        auto symbol_addr = parse_internal_symbol(symbol);
-        g->alias_node(symbol_addr, n);
+        auto symbol = decode_internal_symbol(value["internalSymbol"].as_string());
+        g->alias_node(symbol.addr, n);
     }
     if (value["externalConnection"].error == SUCCESS) {
         auto const &connection = value["externalConnection"];
@@ -944,93 +951,234 @@ Node *parse_net(T value, Graph *g, Node *parent) {
         assert_(direction.error == SUCCESS, "cannot find direction from port");
         auto direction_str = std::string(direction.as_string());
         if (direction_str == "Out")
-            n->port_type = PortType::Output;
+            n->mutable_info().port_type = PortType::Output;
         else
-            n->port_type = PortType::Input;
+            n->mutable_info().port_type = PortType::Input;
     }
 
     return n;
 }
 
-static std::unordered_set<std::string> don_t_care_kind = {  // NOLINT
-    "TransparentMember",   "TypeAlias",     "StatementBlock",
-    "Subroutine",          "EmptyArgument", "Empty",
-    "VariableDeclaration", "ImplicitEvent", "Delay"};
+enum class AstKind : uint8_t {
+    DontCare,
+    ModuleInstance,
+    Net,
+    NamedValue,
+    Assignment,
+    ContinuousAssign,
+    Parameter,
+    BinaryOp,
+    Conversion,
+    Block,
+    Timed,
+    ExpressionStatement,
+    List,
+    Conditional,
+    NumLiteral,
+    Case,
+    RangeSelect,
+    Concatenation,
+    ElementSelect,
+    ConditionalOp,
+    UnaryOp,
+    Replication,
+    Loop,
+    Call,
+    GenerateBlock,
+    EventList,
+    SignalEvent,
+    MemberAccess,
+    RealLiteral,
+    Gate,
+    GenerateBlockArray,
+    Genvar
+};
+
+struct AstKindEntry {
+    std::string_view name;
+    AstKind kind;
+};
+
+constexpr AstKindEntry AST_KINDS[] = {{"CompilationUnit", AstKind::DontCare},
+                                      {"TransparentMember", AstKind::DontCare},
+                                      {"TypeAlias", AstKind::DontCare},
+                                      {"StatementBlock", AstKind::DontCare},
+                                      {"Subroutine", AstKind::DontCare},
+                                      {"EmptyArgument", AstKind::DontCare},
+                                      {"Empty", AstKind::DontCare},
+                                      {"VariableDeclaration", AstKind::DontCare},
+                                      {"ImplicitEvent", AstKind::DontCare},
+                                      {"Delay", AstKind::DontCare},
+                                      {"ModuleInstance", AstKind::ModuleInstance},
+                                      {"Port", AstKind::Net},
+                                      {"Net", AstKind::Net},
+                                      {"Variable", AstKind::Net},
+                                      {"NamedValue", AstKind::NamedValue},
+                                      {"Assignment", AstKind::Assignment},
+                                      {"ContinuousAssign", AstKind::ContinuousAssign},
+                                      {"Parameter", AstKind::Parameter},
+                                      {"BinaryOp", AstKind::BinaryOp},
+                                      {"Conversion", AstKind::Conversion},
+                                      {"ProceduralBlock", AstKind::Block},
+                                      {"Block", AstKind::Block},
+                                      {"Timed", AstKind::Timed},
+                                      {"ExpressionStatement", AstKind::ExpressionStatement},
+                                      {"List", AstKind::List},
+                                      {"Conditional", AstKind::Conditional},
+                                      {"IntegerLiteral", AstKind::NumLiteral},
+                                      {"StringLiteral", AstKind::NumLiteral},
+                                      {"UnbasedUnsizedIntegerLiteral", AstKind::NumLiteral},
+                                      {"Case", AstKind::Case},
+                                      {"RangeSelect", AstKind::RangeSelect},
+                                      {"Concatenation", AstKind::Concatenation},
+                                      {"ElementSelect", AstKind::ElementSelect},
+                                      {"ConditionalOp", AstKind::ConditionalOp},
+                                      {"UnaryOp", AstKind::UnaryOp},
+                                      {"Replication", AstKind::Replication},
+                                      {"ForLoop", AstKind::Loop},
+                                      {"ForeverLoop", AstKind::Loop},
+                                      {"Call", AstKind::Call},
+                                      {"GenerateBlock", AstKind::GenerateBlock},
+                                      {"EventList", AstKind::EventList},
+                                      {"SignalEvent", AstKind::SignalEvent},
+                                      {"MemberAccess", AstKind::MemberAccess},
+                                      {"RealLiteral", AstKind::RealLiteral},
+                                      {"Gate", AstKind::Gate},
+                                      {"GenerateBlockArray", AstKind::GenerateBlockArray},
+                                      {"Genvar", AstKind::Genvar}};
+constexpr uint32_t NUM_AST_KINDS = sizeof(AST_KINDS) / sizeof(AstKindEntry);
+constexpr uint32_t UNKNOWN_AST_KIND = NUM_AST_KINDS;
+
+// perfect hash over the known kinds: FNV-1a followed by a multiplicative hash. the multiplier
+// is picked so that there is no collision, which is checked at compile time
+constexpr uint32_t AST_KIND_TABLE_BITS = 7;
+constexpr uint32_t AST_KIND_HASH_MULTIPLIER = 12921;
+
+constexpr uint32_t ast_kind_hash(std::string_view kind) {
+    uint32_t hash = 2166136261u;
+    for (auto const c : kind) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
+    }
+    return (hash * AST_KIND_HASH_MULTIPLIER) >> (32u - AST_KIND_TABLE_BITS);
+}
+
+// slot -> index into AST_KINDS + 1. 0 means empty
+using AstKindTable = std::array<uint8_t, 1u << AST_KIND_TABLE_BITS>;
+
+constexpr AstKindTable build_ast_kind_table() {
+    AstKindTable table{};
+    for (uint32_t i = 0; i < NUM_AST_KINDS; i++) {
+        table[ast_kind_hash(AST_KINDS[i].name)] = static_cast<uint8_t>(i + 1);
+    }
+    return table;
+}
+
+constexpr AstKindTable AST_KIND_TABLE = build_ast_kind_table();
+
+constexpr bool is_perfect_ast_kind_hash() {
+    for (uint32_t i = 0; i < NUM_AST_KINDS; i++) {
+        if (AST_KIND_TABLE[ast_kind_hash(AST_KINDS[i].name)] != i + 1) return false;
+    }
+    return true;
+}
+
+static_assert(is_perfect_ast_kind_hash(), "AST kind hash collision. Change the multiplier");
+
+// index into AST_KINDS, or UNKNOWN_AST_KIND
+uint32_t find_ast_kind(std::string_view kind) {
+    uint32_t index = AST_KIND_TABLE[ast_kind_hash(kind)];
+    if (index != 0 && AST_KINDS[index - 1].name == kind) return index - 1;
+    return UNKNOWN_AST_KIND;
+}
+
+#ifdef PASTAFARIAN_PARSER_STATS
+// the last one is for unknown kinds
+static std::array<std::atomic<uint64_t>, NUM_AST_KINDS + 1> ast_kind_hits;  // NOLINT
+#endif
 
 template <class T>
 Node *parse_dispatch(T value, Graph *g, Node *parent) {
     assert_(value["kind"].error == SUCCESS, "kind not find in node");
-    auto ast_kind = std::string(value["kind"].as_string());
-    if (ast_kind == "CompilationUnit" || don_t_care_kind.find(ast_kind) != don_t_care_kind.end()) {
-        // don't care
-    } else if (ast_kind == "ModuleInstance") {
-        // this is a module
-        return parse_module(value, g, parent);
-    } else if (ast_kind == "Port" || ast_kind == "Net" || ast_kind == "Variable") {
-        return parse_net(value, g, parent);
-    } else if (ast_kind == "NamedValue") {
-        return parse_named_value(value, g);
-    } else if (ast_kind == "Assignment") {
-        return parse_assignment(value, g, parent);
-    } else if (ast_kind == "EmptyArgument") {
-        return nullptr;
-    } else if (ast_kind == "ContinuousAssign") {
-        return parse_continuous_assignment(value, g, parent);
-    } else if (ast_kind == "Parameter") {
-        return parse_param(value, g, parent);
-    } else if (ast_kind == "BinaryOp") {
-        return parse_binary_op(value, g);
-    } else if (ast_kind == "Conversion") {
-        return parse_conversion(value, g);
-    } else if (ast_kind == "ProceduralBlock" || ast_kind == "Block") {
-        return parse_block(value, g, parent);
-    } else if (ast_kind == "Timed") {
-        return parse_timed(value, g, parent);
-    } else if (ast_kind == "ExpressionStatement") {
-        return parse_expression_stmt(value, g, parent);
-    } else if (ast_kind == "List") {
-        return parse_list(value, g, parent);
-    } else if (ast_kind == "Conditional") {
-        return parse_conditional(value, g, parent);
-    } else if (ast_kind == "IntegerLiteral" || ast_kind == "StringLiteral" ||
-               ast_kind == "UnbasedUnsizedIntegerLiteral") {
-        return parse_num_literal(value, g);
-    } else if (ast_kind == "Case") {
-        return parse_case(value, g, parent);
-    } else if (ast_kind == "RangeSelect") {
-        return parse_range_select(value, g);
-    } else if (ast_kind == "Concatenation") {
-        return parse_concat(value, g);
-    } else if (ast_kind == "ElementSelect") {
-        return parse_element_select(value, g);
-    } else if (ast_kind == "ConditionalOp") {
-        return parse_ternary(value, g);
-    } else if (ast_kind == "UnaryOp") {
-        return parse_unary(value, g);
-    } else if (ast_kind == "Replication") {
-        return parse_replication(value, g);
-    } else if (ast_kind == "ForLoop" || ast_kind == "ForeverLoop") {
-        return parse_for_loop(value, g, parent);
-    } else if (ast_kind == "Call") {
-        return parse_call(value, g, parent);
-    } else if (ast_kind == "GenerateBlock") {
-        parse_generate_block(value, g, parent);
-    } else if (ast_kind == "EventList") {
-        parse_event_list(value, g, parent);
-    } else if (ast_kind == "SignalEvent") {
-        parse_signal_event(value, g, parent);
-    } else if (ast_kind == "MemberAccess") {
-        return parse_member_access(value, g);
-    } else if (ast_kind == "RealLiteral") {
-        return parse_real_literal(value, g);
-    } else if (ast_kind == "Gate") {
-        return parse_gate(value, g, parent);
-    } else if (ast_kind == "GenerateBlockArray") {
-        return parse_generated_block_array(value, g, parent);
-    } else if (ast_kind == "Genvar") {
-        return parse_genvar(value, g, parent);
-    } else {
+    std::string_view ast_kind = value["kind"].as_string();
+    auto index = find_ast_kind(ast_kind);
+#ifdef PASTAFARIAN_PARSER_STATS
+    ast_kind_hits[index].fetch_add(1, std::memory_order_relaxed);
+#endif
+    if (index == UNKNOWN_AST_KIND) {
         std::cerr << "Unable to parse AST node kind " << ast_kind << std::endl;
+        return nullptr;
+    }
+
+    switch (AST_KINDS[index].kind) {
+        case AstKind::DontCare:
+            return nullptr;
+        case AstKind::ModuleInstance:
+            // this is a module
+            return parse_module(value, g, parent);
+        case AstKind::Net:
+            return parse_net(value, g, parent);
+        case AstKind::NamedValue:
+            return parse_named_value(value, g);
+        case AstKind::Assignment:
+            return parse_assignment(value, g, parent);
+        case AstKind::ContinuousAssign:
+            return parse_continuous_assignment(value, g, parent);
+        case AstKind::Parameter:
+            return parse_param(value, g, parent);
+        case AstKind::BinaryOp:
+            return parse_binary_op(value, g);
+        case AstKind::Conversion:
+            return parse_conversion(value, g);
+        case AstKind::Block:
+            return parse_block(value, g, parent);
+        case AstKind::Timed:
+            return parse_timed(value, g, parent);
+        case AstKind::ExpressionStatement:
+            return parse_expression_stmt(value, g, parent);
+        case AstKind::List:
+            return parse_list(value, g, parent);
+        case AstKind::Conditional:
+            return parse_conditional(value, g, parent);
+        case AstKind::NumLiteral:
+            return parse_num_literal(value, g);
+        case AstKind::Case:
+            return parse_case(value, g, parent);
+        case AstKind::RangeSelect:
+            return parse_range_select(value, g);
+        case AstKind::Concatenation:
+            return parse_concat(value, g);
+        case AstKind::ElementSelect:
+            return parse_element_select(value, g);
+        case AstKind::ConditionalOp:
+            return parse_ternary(value, g);
+        case AstKind::UnaryOp:
+            return parse_unary(value, g);
+        case AstKind::Replication:
+            return parse_replication(value, g);
+        case AstKind::Loop:
+            return parse_for_loop(value, g, parent);
+        case AstKind::Call:
+            return parse_call(value, g, parent);
+        case AstKind::GenerateBlock:
+            parse_generate_block(value, g, parent);
+            return nullptr;
+        case AstKind::EventList:
+            parse_event_list(value, g, parent);
+            return nullptr;
+        case AstKind::SignalEvent:
+            parse_signal_event(value, g, parent);
+            return nullptr;
+        case AstKind::MemberAccess:
+            return parse_member_access(value, g);
+        case AstKind::RealLiteral:
+            return parse_real_literal(value, g);
+        case AstKind::Gate:
+            return parse_gate(value, g, parent);
+        case AstKind::GenerateBlockArray:
+            return parse_generated_block_array(value, g, parent);
+        case AstKind::Genvar:
+            return parse_genvar(value, g, parent);
     }
     return nullptr;
 }
@@ -1066,6 +1214,19 @@ void Parser::parse(const std::string &filename) {
     parser_result_ = r;
 }
 
+std::vector<std::pair<std::string, uint64_t>> Parser::ast_kind_stats() {
+    std::vector<std::pair<std::string, uint64_t>> result;
+#ifdef PASTAFARIAN_PARSER_STATS
+    for (uint32_t i = 0; i <= NUM_AST_KINDS; i++) {
+        auto count = ast_kind_hits[i].load(std::memory_order_relaxed);
+        if (count == 0) continue;
+        result.emplace_back(i == UNKNOWN_AST_KIND ? "Unknown" : std::string(AST_KINDS[i].name),
+                            count);
+    }
+#endif
+    return result;
+}
+
 bool Parser::has_slang() { return !get_slang().empty(); }
 
 std::string Parser::get_slang() {
@@ -21,6 +21,9 @@ public:
 
     [[nodiscard]] static bool has_slang();
     [[nodiscard]] static std::string get_slang();
+    // number of AST nodes parsed per slang kind. only available when the library is built with
+    // PASTAFARIAN_PARSER_STATS, otherwise it's empty
+    [[nodiscard]] static std::vector<std::pair<std::string, uint64_t>> ast_kind_stats();
 
 private:
     Graph *graph_;
@@ -0,0 +1,293 @@
+#include "stats.hh"
+
+#include <algorithm>
+
+#include "graph.hh"
+
+#ifdef _WIN32
+#include <ctime>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace fsm {
+
+double process_cpu_time() {
+#ifdef _WIN32
+    return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#else
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    auto seconds = [](const timeval &t) {
+        return static_cast<double>(t.tv_sec) + static_cast<double>(t.tv_usec) / 1e6;
+    };
+    return seconds(usage.ru_utime) + seconds(usage.ru_stime);
+#endif
+}
+
+uint64_t process_peak_rss() {
+#ifdef _WIN32
+    return 0;
+#else
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    auto peak = static_cast<uint64_t>(usage.ru_maxrss);
+#ifdef __APPLE__
+    return peak;
+#else
+    // linux reports kilobytes
+    return peak * 1024;
+#endif
+#endif
+}
+
+Stats &Stats::instance() {
+    static Stats stats;
+    return stats;
+}
+
+void Stats::set_enabled(bool value) {
+    std::lock_guard guard(mutex_);
+    if (value && !enabled()) start_ = std::chrono::steady_clock::now();
+    enabled_.store(value, std::memory_order_relaxed);
+}
+
+void Stats::count(std::string_view name, uint64_t value) {
+    if (!enabled()) return;
+    std::lock_guard guard(mutex_);
+    if (open_.empty()) return;
+    auto &counters = phases_[open_.back()].counters;
+    auto it = std::find_if(counters.begin(), counters.end(),
+                           [name](auto const &counter) { return counter.first == name; });
+    if (it == counters.end()) {
+        counters.emplace_back(name, value);
+    } else {
+        it->second += value;
+    }
+}
+
+std::vector<PhaseStats> Stats::phases() const {
+    std::lock_guard guard(mutex_);
+    return phases_;
+}
+
+void Stats::clear() {
+    std::lock_guard guard(mutex_);
+    phases_.clear();
+    open_.clear();
+    start_ = std::chrono::steady_clock::now();
+}
+
+void Stats::write(json::JSONWriter &w) const {
+    std::lock_guard guard(mutex_);
+    std::chrono::duration<double> wall_time = std::chrono::steady_clock::now() - start_;
+    w.start_object();
+    w.start_object("total");
+    w.write("wall_time", wall_time.count());
+    w.write("cpu_time", process_cpu_time());
+    w.write("peak_rss", process_peak_rss());
+    w.end_object();
+
+    w.start_array("phases");
+    for (auto const &phase : phases_) {
+        w.start_object();
+        w.write("name", phase.name);
+        w.write("depth", phase.depth);
+        w.write("wall_time", phase.wall_time);
+        w.write("cpu_time", phase.cpu_time);
+        w.write("peak_rss", phase.peak_rss);
+        w.write("peak_rss_increase", phase.peak_rss_increase);
+        w.start_object("counters");
+        for (auto const &[name, value] : phase.counters) {
+            w.write(name, value);
+        }
+        w.end_object();
+        w.end_object();
+    }
+    w.end_array();
+    w.end_object();
+    w.flush();
+}
+
+uint64_t Stats::begin(std::string_view name) {
+    std::lock_guard guard(mutex_);
+    PhaseStats phase;
+    phase.depth = open_.size();
+    phase.name = open_.empty() ? std::string(name)
+                               : fmt::format("{0}/{1}", phases_[open_.back()].name, name);
+    auto index = phases_.size();
+    phases_.emplace_back(std::move(phase));
+    open_.emplace_back(index);
+    return index;
+}
+
+void Stats::end(uint64_t index, double wall_time, double cpu_time, uint64_t peak_rss,
+                uint64_t peak_rss_increase) {
+    std::lock_guard guard(mutex_);
+    // cleared while the phase was open
+    if (open_.empty() || open_.back() != index) return;
+    open_.pop_back();
+    auto &phase = phases_[index];
+    phase.wall_time = wall_time;
+    phase.cpu_time = cpu_time;
+    phase.peak_rss = peak_rss;
+    phase.peak_rss_increase = peak_rss_increase;
+}
+
+ScopedPhase::ScopedPhase(std::string_view name) : active_(Stats::instance().enabled()) {
+    if (active_) {
+        index_ = Stats::instance().begin(name);
+        rss_start_ = process_peak_rss();
+        cpu_start_ = process_cpu_time();
+    }
+    auto &trace = Trace::instance();
+    if (trace.enabled()) {
+        // use the nested name if there is one
+        if (active_) {
+            auto &stats = Stats::instance();
+            std::lock_guard guard(stats.mutex_);
+            trace_name_ = trace.intern(stats.phases_[index_].name);
+        } else {
+            trace_name_ = trace.intern(name);
+        }
+    }
+    wall_start_ = std::chrono::steady_clock::now();
+}
+
+void ScopedPhase::stop() {
+    auto end = std::chrono::steady_clock::now();
+    if (trace_name_) {
+        Trace::instance().record(trace_name_, "phase", wall_start_, end);
+        trace_name_ = nullptr;
+    }
+    if (!active_) return;
+    active_ = false;
+    std::chrono::duration<double> wall_time = end - wall_start_;
+    auto cpu_time = process_cpu_time() - cpu_start_;
+    auto peak_rss = process_peak_rss();
+    Stats::instance().end(index_, wall_time.count(), cpu_time, peak_rss, peak_rss - rss_start_);
+}
+
+Trace &Trace::instance() {
+    static Trace trace;
+    return trace;
+}
+
+void Trace::set_enabled(bool value) {
+    std::lock_guard guard(mutex_);
+    if (value && !enabled()) start_ = Clock::now();
+    enabled_.store(value, std::memory_order_relaxed);
+}
+
+Trace::Buffer &Trace::buffer() {
+    // the buffer is only ever touched by its own thread until the trace is written
+    thread_local Buffer *cached = nullptr;
+    thread_local uint64_t cached_generation = 0;
+    auto generation = generation_.load(std::memory_order_acquire);
+    if (!cached || cached_generation != generation) {
+        std::lock_guard guard(mutex_);
+        auto tid = static_cast<uint32_t>(buffers_.size() + 1);
+        cached = buffers_.emplace_back(std::make_unique<Buffer>(Buffer{tid, {}})).get();
+        cached_generation = generation;
+    }
+    return *cached;
+}
+
+void Trace::record(const char *name, const char *category, Clock::time_point begin,
+                   Clock::time_point end, const Node *node, const Node *other) {
+    if (!enabled()) return;
+    buffer().events.emplace_back(Event{name, category, begin, end, node, other});
+}
+
+const char *Trace::intern(std::string_view name) {
+    std::lock_guard guard(mutex_);
+    return names_.emplace_back(name).c_str();
+}
+
+uint64_t Trace::size() const {
+    std::lock_guard guard(mutex_);
+    uint64_t size = 0;
+    for (auto const &buffer : buffers_) size += buffer->events.size();
+    return size;
+}
+
+void Trace::clear() {
+    std::lock_guard guard(mutex_);
+    buffers_.clear();
+    names_.clear();
+    generation_.fetch_add(1, std::memory_order_release);
+    start_ = Clock::now();
+}
+
+// nodes under anonymous ones, e.g. control blocks, don't have a hierarchical name
+void write_node(json::JSONWriter &w, std::string_view key, const Node *node) {
+    bool named = true;
+    for (auto const *n = node; n && named; n = n->parent) named = !n->name.empty();
+    if (named) {
+        w.write(key, node->handle_name());
+    } else if (!node->name.empty()) {
+        w.write(key, node->name);
+    } else {
+        w.write(key, fmt::format("<{0}>", node->id));
+    }
+}
+
+void Trace::write(json::JSONWriter &w) const {
+    std::lock_guard guard(mutex_);
+    auto microseconds = [this](Clock::time_point time) {
+        return std::chrono::duration<double, std::micro>(time - start_).count();
+    };
+    w.start_object();
+    w.start_array("traceEvents");
+    for (auto const &buffer : buffers_) {
+        // name the threads in the viewer
+        w.start_object();
+        w.write("name", "thread_name");
+        w.write("ph", "M");
+        w.write("pid", 1);
+        w.write("tid", buffer->tid);
+        w.start_object("args");
+        w.write("name", fmt::format("thread {0}", buffer->tid));
+        w.end_object();
+        w.end_object();
+
+        for (auto const &event : buffer->events) {
+            w.start_object();
+            w.write("name", event.name);
+            w.write("cat", event.category);
+            w.write("ph", "X");
+            w.write("ts", microseconds(event.begin));
+            w.write("dur", microseconds(event.end) - microseconds(event.begin));
+            w.write("pid", 1);
+            w.write("tid", buffer->tid);
+            if (event.node) {
+                w.start_object("args");
+                write_node(w, "node", event.node);
+                if (event.other) write_node(w, "other", event.other);
+                w.end_object();
+            }
+            w.end_object();
+        }
+    }
+    w.end_array();
+    w.end_object();
+    w.flush();
+}
+
+ScopedTrace::ScopedTrace(const char *name, const char *category, const Node *node,
+                         const Node *other)
+    : active_(Trace::instance().enabled()),
+      name_(name),
+      category_(category),
+      node_(node),
+      other_(other) {
+    if (active_) begin_ = Trace::Clock::now();
+}
+
+void ScopedTrace::stop() {
+    if (!active_) return;
+    active_ = false;
+    Trace::instance().record(name_, category_, begin_, Trace::Clock::now(), node_, other_);
+}
+
+}  // namespace fsm
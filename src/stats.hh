@@ -0,0 +1,161 @@
+#ifndef PASTAFARIAN_STATS_HH
+#define PASTAFARIAN_STATS_HH
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "util.hh"
+
+namespace fsm {
+
+class Node;
+
+struct PhaseStats {
+    // nested phases are named parent/child
+    std::string name;
+    uint32_t depth = 0;
+    // seconds
+    double wall_time = 0;
+    // user + system time of the whole process, i.e. all threads, in seconds
+    double cpu_time = 0;
+    // process high-water mark at the end of the phase and how much the phase raised it, in bytes
+    uint64_t peak_rss = 0;
+    uint64_t peak_rss_increase = 0;
+    // in the order they are first counted
+    std::vector<std::pair<std::string, uint64_t>> counters;
+};
+
+// process-wide phase statistics. nothing is recorded until it is enabled, so the instrumentation
+// in the library is a single branch otherwise
+class Stats {
+public:
+    static Stats &instance();
+
+    void set_enabled(bool value);
+    [[nodiscard]] bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+    // adds value to the counter of the innermost open phase. safe to call from worker threads
+    void count(std::string_view name, uint64_t value);
+    [[nodiscard]] std::vector<PhaseStats> phases() const;
+    void clear();
+    // {"total": {...}, "phases": [...]}
+    void write(json::JSONWriter &w) const;
+
+private:
+    friend class ScopedPhase;
+
+    mutable std::mutex mutex_;
+    std::atomic<bool> enabled_{false};
+    std::chrono::steady_clock::time_point start_;
+    std::vector<PhaseStats> phases_;
+    // indices into phases_
+    std::vector<uint64_t> open_;
+
+    uint64_t begin(std::string_view name);
+    void end(uint64_t index, double wall_time, double cpu_time, uint64_t peak_rss,
+             uint64_t peak_rss_increase);
+};
+
+// records the enclosing scope as a phase if stats are enabled, and as a trace event if tracing is
+// enabled. phases have to be opened and closed on the same thread in LIFO order
+class ScopedPhase {
+public:
+    explicit ScopedPhase(std::string_view name);
+    ~ScopedPhase() { stop(); }
+    ScopedPhase(const ScopedPhase &) = delete;
+    ScopedPhase &operator=(const ScopedPhase &) = delete;
+
+    // ends the phase before the scope does
+    void stop();
+
+private:
+    bool active_;
+    const char *trace_name_ = nullptr;
+    uint64_t index_ = 0;
+    std::chrono::steady_clock::time_point wall_start_;
+    double cpu_start_ = 0;
+    uint64_t rss_start_ = 0;
+};
+
+// task-level trace in the Chrome trace-event format, which can be opened in chrome://tracing or
+// Perfetto. every thread appends to its own buffer, so recording doesn't take any lock once the
+// thread has recorded its first event
+class Trace {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static Trace &instance();
+
+    void set_enabled(bool value);
+    [[nodiscard]] bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+    // name and category have to outlive the trace, e.g. string literals. the nodes are only
+    // dereferenced when the trace is written, so the graph has to outlive the trace as well
+    void record(const char *name, const char *category, Clock::time_point begin,
+                Clock::time_point end, const Node *node = nullptr, const Node *other = nullptr);
+    // makes a copy of the name that lives as long as the trace
+    const char *intern(std::string_view name);
+    [[nodiscard]] uint64_t size() const;
+    // neither clear nor write can run while other threads are recording
+    void clear();
+    // {"traceEvents": [...]}
+    void write(json::JSONWriter &w) const;
+
+private:
+    struct Event {
+        const char *name;
+        const char *category;
+        Clock::time_point begin;
+        Clock::time_point end;
+        const Node *node;
+        const Node *other;
+    };
+    struct Buffer {
+        uint32_t tid;
+        std::vector<Event> events;
+    };
+
+    std::atomic<bool> enabled_{false};
+    Clock::time_point start_ = Clock::now();
+    // bumped by clear() so that threads drop their cached buffer
+    std::atomic<uint64_t> generation_{0};
+    // only guards adding buffers and interned names
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Buffer>> buffers_;
+    std::deque<std::string> names_;
+
+    Buffer &buffer();
+};
+
+// records the enclosing scope as a trace event if tracing is enabled
+class ScopedTrace {
+public:
+    ScopedTrace(const char *name, const char *category, const Node *node = nullptr,
+                const Node *other = nullptr);
+    ~ScopedTrace() { stop(); }
+    ScopedTrace(const ScopedTrace &) = delete;
+    ScopedTrace &operator=(const ScopedTrace &) = delete;
+
+    void stop();
+
+private:
+    bool active_;
+    const char *name_;
+    const char *category_;
+    const Node *node_;
+    const Node *other_;
+    Trace::Clock::time_point begin_;
+};
+
+// user + system time of the process in seconds
+double process_cpu_time();
+// peak resident set size of the process in bytes. 0 if the platform doesn't report it
+uint64_t process_peak_rss();
+
+}  // namespace fsm
+
+#endif  // PASTAFARIAN_STATS_HH
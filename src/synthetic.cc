@@ -0,0 +1,195 @@
+#include "synthetic.hh"
+
+#include <fmt/format.h>
+
+#include <cmath>
+#include <random>
+
+namespace fsm {
+
+uint32_t SyntheticOptions::counters_per_module() const {
+    auto count = static_cast<uint32_t>(std::lround(counter_ratio * fsms_per_module));
+    return std::min(count, fsms_per_module);
+}
+
+uint32_t state_width(uint32_t num_states) {
+    uint32_t width = 1;
+    while ((1ull << width) < num_states) width++;
+    return width;
+}
+
+class DesignBuilder {
+public:
+    DesignBuilder(Graph *g, const SyntheticOptions &options)
+        : g_(g), options_(options), rng_(options.seed) {}
+
+    Node *build() {
+        auto top = add("top", NodeType::Module, nullptr);
+        auto &def = top->mutable_info().module_def;
+        def = std::make_unique<ModuleDefInfo>();
+        def->name = "top";
+        add_port(top, "clk", EventType::Posedge);
+        add_port(top, "rst", EventType::Posedge);
+        for (uint32_t i = 0; i < options_.num_instances; i++) {
+            add_module(top, i);
+        }
+        return top;
+    }
+
+private:
+    Graph *g_;
+    const SyntheticOptions &options_;
+    std::mt19937_64 rng_;
+
+    Node *add(const std::string &name, NodeType type, Node *parent) {
+        return g_->add_node(g_->get_free_id(), name, type, parent);
+    }
+
+    Node *add_port(Node *module, const std::string &name, EventType event_type) {
+        auto port = add(name, NodeType::Variable, module);
+        auto &info = port->mutable_info();
+        info.port_type = PortType::Input;
+        info.event_type = event_type;
+        info.wire_type = "logic";
+        return port;
+    }
+
+    Node *add_state(Node *module, const std::string &name, uint32_t width) {
+        auto state = add(name, NodeType::Variable, module);
+        state->mutable_info().wire_type = fmt::format("logic[{0}:0]", width - 1);
+        return state;
+    }
+
+    // case item, i.e. case (state) value: ...
+    Node *add_case_item(Node *module, Node *state, int64_t value, uint32_t width) {
+        auto net = add("", NodeType::Net, module);
+        g_->add_constant(value, width)->add_edge(net);
+        auto item = add("", NodeType::Control, module);
+        item->op = NetOpType::Equal;
+        net->add_edge(item);
+        state->add_edge(item);
+        return item;
+    }
+
+    // expression state == value
+    Node *add_equal(Node *state, int64_t value, uint32_t width) {
+        auto net = add("", NodeType::Net, nullptr);
+        net->op = NetOpType::Equal;
+        g_->add_constant(value, width)->add_edge(net);
+        state->add_edge(net);
+        return net;
+    }
+
+    // if (cond) begin ... end else begin ... end. returns the node to hang the else branch on
+    Node *add_else(Node *cond) {
+        auto negate = add("", NodeType::Control, cond);
+        negate->op = NetOpType::LogicalNot;
+        cond->add_edge(negate, EdgeType::False);
+        return negate;
+    }
+
+    Node *add_assign(Node *cond, Node *from, Node *to, EdgeType type) {
+        auto assign = add("", NodeType::Assign, cond);
+        cond->add_edge(assign, EdgeType::Control);
+        from->add_edge(assign);
+        assign->add_edge(to, type);
+        return assign;
+    }
+
+    // if (rst) state <= 0; else state <= next;
+    void add_reset(Node *module, Node *rst, Node *state, Node *next, uint32_t width) {
+        auto cond = add("", NodeType::Control, module);
+        rst->add_edge(cond);
+        add_assign(cond, g_->add_constant(0, width), state, EdgeType::NonBlocking);
+        add_assign(add_else(cond), next, state, EdgeType::NonBlocking);
+    }
+
+    void add_counter(Node *module, Node *rst, Node *state, uint32_t width) {
+        auto next = add_state(module, state->name + "_next", width);
+        add_reset(module, rst, state, next, width);
+        // if (state == max) next = 0; else next = state + 1;
+        auto wrap = add_case_item(module, state, options_.states_per_fsm - 1, width);
+        add_assign(wrap, g_->add_constant(0, width), next, EdgeType::Blocking);
+        auto sum = add("", NodeType::Net, nullptr);
+        sum->op = NetOpType::Add;
+        state->add_edge(sum);
+        g_->add_constant(1, width)->add_edge(sum);
+        add_assign(add_else(wrap), sum, next, EdgeType::Blocking);
+    }
+
+    void add_fsm(Node *module, Node *rst, Node *state, Node *input,
+                 const std::vector<Node *> &states, uint32_t index, uint32_t width) {
+        auto next = add_state(module, state->name + "_next", width);
+        add_reset(module, rst, state, next, width);
+
+        std::bernoulli_distribution coupled(options_.coupling_density);
+        std::uniform_int_distribution<uint64_t> pick(0, states.size() - 1);
+        auto num_states = options_.states_per_fsm;
+        for (uint32_t s = 0; s < num_states; s++) {
+            auto item = add_case_item(module, state, s, width);
+            auto guard = add("", NodeType::Control, item);
+            item->add_edge(guard, EdgeType::Control);
+            if (states.size() > 1 && coupled(rng_)) {
+                auto other = index;
+                while (other == index) other = pick(rng_);
+                add_equal(states[other], 1, width)->add_edge(guard);
+            } else {
+                input->add_edge(guard);
+            }
+            auto value = g_->add_constant((s + 1) % num_states, width);
+            add_assign(guard, value, next, EdgeType::Blocking);
+        }
+    }
+
+    // data <= data + in;
+    void add_noise(Node *module, Node *input, uint32_t index) {
+        auto data = add_state(module, fmt::format("data{0}", index), 32);
+        auto sum = add("", NodeType::Net, nullptr);
+        sum->op = NetOpType::Add;
+        data->add_edge(sum);
+        input->add_edge(sum);
+        auto assign = add("", NodeType::Assign, module);
+        sum->add_edge(assign);
+        assign->add_edge(data, EdgeType::NonBlocking);
+    }
+
+    void add_module(Node *top, uint32_t index) {
+        auto module = add(fmt::format("inst{0}", index), NodeType::Module, top);
+        auto &def = module->mutable_info().module_def;
+        def = std::make_unique<ModuleDefInfo>();
+        def->name = "fsm_module";
+        add_port(module, "clk", EventType::Posedge);
+        auto rst = add_port(module, "rst", EventType::Posedge);
+
+        auto num_fsms = options_.fsms_per_module;
+        auto num_counters = options_.counters_per_module();
+        auto width = state_width(options_.states_per_fsm);
+        std::vector<Node *> inputs;
+        for (uint32_t i = 0; i < std::max(num_fsms, 1u); i++) {
+            inputs.emplace_back(add_port(module, fmt::format("in{0}", i), EventType::None));
+        }
+        // create all the state variables first so that FSMs can be coupled with later ones
+        std::vector<Node *> states;
+        for (uint32_t i = 0; i < num_fsms; i++) {
+            auto name = i < num_counters ? fmt::format("counter{0}", i) : fmt::format("state{0}", i);
+            states.emplace_back(add_state(module, name, width));
+        }
+        for (uint32_t i = 0; i < num_fsms; i++) {
+            if (i < num_counters) {
+                add_counter(module, rst, states[i], width);
+            } else {
+                add_fsm(module, rst, states[i], inputs[i], states, i, width);
+            }
+        }
+        for (uint32_t i = 0; i < options_.noise_registers; i++) {
+            add_noise(module, inputs[i % inputs.size()], i);
+        }
+    }
+};
+
+Node *generate_design(Graph *g, const SyntheticOptions &options) {
+    DesignBuilder builder(g, options);
+    return builder.build();
+}
+
+}  // namespace fsm
@@ -0,0 +1,44 @@
+#ifndef PASTAFARIAN_SYNTHETIC_HH
+#define PASTAFARIAN_SYNTHETIC_HH
+
+#include "graph.hh"
+
+namespace fsm {
+
+// parameters of a synthetic design. the graph has the same shape as what the parser produces for
+// the RTL below, so every analysis phase can be exercised at any scale without slang
+//
+// module fsm_module(input clk, rst, in0, in1, ...);
+//   // one per FSM. counters simply wrap around
+//   always_ff @(posedge clk, posedge rst)
+//     if (rst) state <= 0; else state <= state_next;
+//   always_comb
+//     case (state)
+//       0: if (in0 /* or another_state == 1 when coupled */) state_next = 1;
+//       ...
+//     endcase
+//   // datapath noise
+//   always_ff @(posedge clk) data <= data + in0;
+// endmodule
+struct SyntheticOptions {
+    uint32_t num_instances = 1;
+    uint32_t fsms_per_module = 1;
+    uint32_t states_per_fsm = 4;
+    // fraction of the FSMs per module that are counters
+    double counter_ratio = 0;
+    // probability that a state transition depends on the state of another FSM in the same module
+    // instead of an input port
+    double coupling_density = 0;
+    // registers per module that are not driven by constants
+    uint32_t noise_registers = 0;
+    uint64_t seed = 0;
+
+    [[nodiscard]] uint32_t counters_per_module() const;
+};
+
+// builds the design into g and returns the top module. every instance is a child of the top
+Node* generate_design(Graph* g, const SyntheticOptions& options);
+
+}  // namespace fsm
+
+#endif  // PASTAFARIAN_SYNTHETIC_HH
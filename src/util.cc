@@ -13,9 +13,10 @@
 
 namespace fsm {
 
-void assert_(bool condition, const std::string &what) {
+void assert_(bool condition, std::string_view what) {
     if (!condition) {
-        throw std::runtime_error("Assert failed. Reason: " + (what.empty() ? "null" : what));
+        throw std::runtime_error("Assert failed. Reason: " +
+                                 std::string(what.empty() ? "null" : what));
     }
 }
 
@@ -37,6 +38,32 @@ void set_num_cpus(int num_cpu) {
     }
 }
 
+DisjointSet::DisjointSet(uint64_t size) : parent_(size), rank_(size, 0) {
+    for (uint64_t i = 0; i < size; i++) parent_[i] = i;
+}
+
+uint64_t DisjointSet::find(uint64_t x) {
+    auto root = x;
+    while (parent_[root] != root) root = parent_[root];
+    // path compression
+    while (parent_[x] != root) {
+        auto next = parent_[x];
+        parent_[x] = root;
+        x = next;
+    }
+    return root;
+}
+
+bool DisjointSet::merge(uint64_t a, uint64_t b) {
+    a = find(a);
+    b = find(b);
+    if (a == b) return false;
+    if (rank_[a] < rank_[b]) std::swap(a, b);
+    parent_[b] = a;
+    if (rank_[a] == rank_[b]) rank_[a]++;
+    return true;
+}
+
 namespace fs {
 std::string which(const std::string &name) {
     // windows is more picky
@@ -205,90 +232,135 @@ void trim(std::string &s) {
 
 std::vector<std::string> get_tokens(std::string_view line, const std::string &delimiter) {
     std::vector<std::string> tokens;
-    size_t prev = 0, pos = 0;
-    std::string token;
-    // copied from https://stackoverflow.com/a/7621814
-    while ((pos = line.find_first_of(delimiter, prev)) != std::string::npos) {
-        if (pos > prev) {
-            tokens.emplace_back(line.substr(prev, pos - prev));
-        }
-        prev = pos + 1;
+    for (auto const &token : split(line, delimiter)) {
+        tokens.emplace_back(token);
     }
-    if (prev < line.length()) tokens.emplace_back(line.substr(prev, std::string::npos));
-    // remove empty ones
-    std::vector<std::string> result;
-    result.reserve(tokens.size());
-    for (auto const &t : tokens)
-        if (!t.empty()) result.emplace_back(t);
-    return result;
+    return tokens;
 }
 
 }  // namespace string
 
 namespace json {
+JSONWriter::~JSONWriter() { flush(); }
+
 JSONWriter &JSONWriter::start_array(std::string_view name) {
-    end();
-    indent();
-    stream_ << "\"" << name << "\": [" << std::endl;
-    indent_ += 2;
-    return *this;
+    key(name);
+    return start('[');
 }
 
 JSONWriter &JSONWriter::start_array() {
-    end();
-    indent();
-    stream_ << '[' << std::endl;
-    indent_ += 2;
-    return *this;
+    next();
+    return start('[');
 }
 
-JSONWriter &JSONWriter::end_array() {
-    // no , at the end of an array
-    stream_ << std::endl;
-    indent_ -= 2;
-    indent();
-    stream_ << "]";
-    end_ = true;
-    return *this;
-}
+JSONWriter &JSONWriter::end_array() { return end(']'); }
 
 JSONWriter &JSONWriter::start_object(std::string_view name) {
-    end();
-    indent();
-    stream_ << "\"" << name << "\": \" {" << std::endl;
-    indent_ += 2;
-    return *this;
+    key(name);
+    return start('{');
 }
 
 JSONWriter &JSONWriter::start_object() {
-    end();
-    indent();
-    stream_ << '{' << std::endl;
-    indent_ += 2;
-    return *this;
+    next();
+    return start('{');
 }
 
-JSONWriter &JSONWriter::end_object() {
-    stream_ << std::endl;
-    // no , at the end of an object
-    indent_ -= 2;
-    indent();
-    stream_ << "}";
-    end_ = true;
-    return *this;
-}
+JSONWriter &JSONWriter::end_object() { return end('}'); }
 
 std::string JSONWriter::str() const {
-    assert_(indent_ == 0, "incorrect JSON hierarchy");
-    return stream_.str();
+    assert_(depth_ == 0, "incorrect JSON hierarchy");
+    assert_(stream_ == nullptr, "JSON has been written to stream");
+    return fmt::to_string(buffer_);
+}
+
+void JSONWriter::flush() {
+    if (!stream_) return;
+    stream_->write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    buffer_.clear();
+}
+
+void JSONWriter::write_string(std::string_view str) {
+    constexpr char hex[] = "0123456789abcdef";
+    buffer_.push_back('"');
+    // copy over the unescaped runs in one go
+    uint64_t run = 0;
+    for (uint64_t i = 0; i < str.size(); i++) {
+        auto c = static_cast<unsigned char>(str[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        append(str.substr(run, i - run));
+        run = i + 1;
+        buffer_.push_back('\\');
+        switch (c) {
+            case '"':
+            case '\\':
+                buffer_.push_back(static_cast<char>(c));
+                break;
+            case '\n':
+                buffer_.push_back('n');
+                break;
+            case '\r':
+                buffer_.push_back('r');
+                break;
+            case '\t':
+                buffer_.push_back('t');
+                break;
+            case '\b':
+                buffer_.push_back('b');
+                break;
+            case '\f':
+                buffer_.push_back('f');
+                break;
+            default: {
+                const char code[] = {'u', '0', '0', hex[c >> 4u], hex[c & 0xFu]};
+                buffer_.append(code, code + sizeof(code));
+            }
+        }
+    }
+    append(str.substr(run));
+    buffer_.push_back('"');
+}
+
+void JSONWriter::key(std::string_view name) {
+    next();
+    write_string(name);
+    append(pretty_ ? ": " : ":");
 }
 
-void JSONWriter::end() {
-    if (end_) {
-        stream_ << "," << std::endl;
-        end_ = false;
+void JSONWriter::next() {
+    if (end_) buffer_.push_back(',');
+    if (depth_ > 0) newline();
+    end_ = false;
+}
+
+void JSONWriter::newline() {
+    if (!pretty_) return;
+    constexpr std::string_view spaces = "                                ";
+    buffer_.push_back('\n');
+    uint64_t indent = depth_ * 2;
+    while (indent > 0) {
+        auto size = std::min<uint64_t>(indent, spaces.size());
+        append(spaces.substr(0, size));
+        indent -= size;
     }
 }
 
+JSONWriter &JSONWriter::start(char c) {
+    buffer_.push_back(c);
+    depth_++;
+    end_ = false;
+    return *this;
+}
+
+JSONWriter &JSONWriter::end(char c) {
+    assert_(depth_ > 0, "incorrect JSON hierarchy");
+    depth_--;
+    // empty arrays and objects stay on the same line
+    if (end_) newline();
+    buffer_.push_back(c);
+    end_ = true;
+    if (stream_ && buffer_.size() >= FLUSH_SIZE) flush();
+    return *this;
+}
+
 }  // namespace json
 }  // namespace fsm
\ No newline at end of file
@@ -1,6 +1,10 @@
 #ifndef PASTAFARIAN_UTIL_HH
 #define PASTAFARIAN_UTIL_HH
 
+#include <fmt/format.h>
+
+#include <iterator>
+#include <ostream>
 #include <sstream>
 #include <string>
 #include <string_view>
@@ -9,11 +13,26 @@
 
 namespace fsm {
 
-void assert_(bool condition, const std::string &what = "");
+void assert_(bool condition, std::string_view what = "");
 
 uint32_t get_num_cpus();
 void set_num_cpus(int num_cpu);
 
+// union-find over [0, size) with path compression and union by rank
+class DisjointSet {
+public:
+    explicit DisjointSet(uint64_t size);
+
+    uint64_t find(uint64_t x);
+    // returns false if they are already in the same set
+    bool merge(uint64_t a, uint64_t b);
+    [[nodiscard]] uint64_t size() const { return parent_.size(); }
+
+private:
+    std::vector<uint64_t> parent_;
+    std::vector<uint8_t> rank_;
+};
+
 // this is from kratos
 namespace fs {
 std::string join(const std::string &path1, const std::string &path2);
@@ -31,6 +50,70 @@ std::string getcwd();
 }  // namespace fs
 
 namespace string {
+// iterates through non-empty tokens separated by any of the delimiter characters.
+// tokens are views into the original string so no allocation is involved
+class TokenIterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::string_view *;
+    using reference = const std::string_view &;
+
+    TokenIterator() = default;
+    TokenIterator(std::string_view line, std::string_view delimiter)
+        : line_(line), delimiter_(delimiter) {
+        next(0);
+    }
+
+    reference operator*() const { return token_; }
+    pointer operator->() const { return &token_; }
+    TokenIterator &operator++() {
+        next(token_.data() - line_.data() + token_.size());
+        return *this;
+    }
+    TokenIterator operator++(int) {
+        auto it = *this;
+        ++(*this);
+        return it;
+    }
+    // end iterator has a null token
+    bool operator==(const TokenIterator &other) const { return token_.data() == other.token_.data(); }
+    bool operator!=(const TokenIterator &other) const { return !(*this == other); }
+
+private:
+    std::string_view line_;
+    std::string_view delimiter_;
+    std::string_view token_;
+
+    inline void next(uint64_t pos) {
+        auto start = line_.find_first_not_of(delimiter_, pos);
+        if (start == std::string_view::npos) {
+            token_ = {};
+            return;
+        }
+        auto end = line_.find_first_of(delimiter_, start);
+        if (end == std::string_view::npos) end = line_.size();
+        token_ = line_.substr(start, end - start);
+    }
+};
+
+class TokenRange {
+public:
+    TokenRange(std::string_view line, std::string_view delimiter)
+        : line_(line), delimiter_(delimiter) {}
+    [[nodiscard]] TokenIterator begin() const { return TokenIterator(line_, delimiter_); }
+    [[nodiscard]] TokenIterator end() const { return TokenIterator(); }
+
+private:
+    std::string_view line_;
+    std::string_view delimiter_;
+};
+
+inline TokenRange split(std::string_view line, std::string_view delimiter) {
+    return TokenRange(line, delimiter);
+}
+
 void trim(std::string &str);
 std::vector<std::string> get_tokens(std::string_view line, const std::string &delimiter);
 template <typename Iter>
@@ -47,18 +130,22 @@ std::string static join(Iter begin, Iter end, const std::string &sep) {
 namespace json {
 class JSONWriter {
 public:
+    // in-memory writer. use str() to obtain the document
+    explicit JSONWriter(bool pretty = true) : pretty_(pretty) {}
+    // streaming writer. the buffer is flushed into the stream as the document grows
+    explicit JSONWriter(std::ostream &stream, bool pretty = true)
+        : pretty_(pretty), stream_(&stream) {}
+    ~JSONWriter();
+
     template <typename T>
-    JSONWriter &write(std::string_view name, T value) {
-        end();
-        indent();
-        stream_ << "\"" << name << "\": ";
+    JSONWriter &write(std::string_view name, const T &value) {
+        key(name);
         return write_(value);
     }
 
     template <typename T>
-    JSONWriter &write(T value) {
-        end();
-        indent();
+    JSONWriter &write(const T &value) {
+        next();
         return write_(value);
     }
 
@@ -71,27 +158,40 @@ public:
     JSONWriter &end_object();
 
     [[nodiscard]] std::string str() const;
+    void flush();
 
 private:
-    uint32_t indent_ = 0;
+    bool pretty_;
+    std::ostream *stream_ = nullptr;
+    fmt::memory_buffer buffer_;
+    uint32_t depth_ = 0;
+    // whether the current array/object already has an entry
     bool end_ = false;
-    std::stringstream stream_;
-
-    inline void indent() {
-        for (uint32_t i = 0; i < indent_; i++) stream_ << ' ';
-    }
 
     template <typename T>
-    JSONWriter &write_(T value) {
-        if constexpr (std::is_same_v<std::string, T>)
-            stream_ << "\"" << value << "\"";
-        else
-            stream_ << value;
+    JSONWriter &write_(const T &value) {
+        if constexpr (std::is_same_v<bool, T>) {
+            append(value ? "true" : "false");
+        } else if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+            write_string(value);
+        } else {
+            static_assert(std::is_arithmetic_v<T>, "unsupported JSON value type");
+            fmt::format_to(std::back_inserter(buffer_), "{0}", value);
+        }
         end_ = true;
+        if (stream_ && buffer_.size() >= FLUSH_SIZE) flush();
         return *this;
     }
 
-    void end();
+    inline void append(std::string_view str) { buffer_.append(str.data(), str.data() + str.size()); }
+    void write_string(std::string_view str);
+    void key(std::string_view name);
+    void next();
+    void newline();
+    JSONWriter &start(char c);
+    JSONWriter &end(char c);
+
+    static constexpr uint64_t FLUSH_SIZE = 1u << 16u;
 };
 }  // namespace json
 
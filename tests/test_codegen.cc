@@ -1,3 +1,5 @@
+#include <fstream>
+
 #include "../src/codegen.hh"
 #include "../src/fsm.hh"
 #include "util.hh"
@@ -17,6 +19,8 @@ TEST_F(GraphTest, fsm1_codegen) {  // NOLINT
 
     // clk, rst, in, out
     EXPECT_EQ(m.ports.size(), 4);
+    EXPECT_EQ(m.top(), fsm::find_top_module(g, ""));
+    EXPECT_EQ(m.top(), fsm::find_top_module(g, m.name));
     EXPECT_FALSE(result.empty());
     EXPECT_EQ(m.reset_type(), fsm::ResetType::Posedge);
     EXPECT_NE(result.find(
@@ -73,4 +77,36 @@ TEST_F(GraphTest, fsm1_codegen_parse) { // NOLINT
     auto red_blue  = m.get_property(state_var, RED, BLUE);
     EXPECT_NE(red_blue, nullptr);
     EXPECT_TRUE(red_blue->valid);
-}
\ No newline at end of file
+}
+
+TEST_F(GraphTest, fsm1_codegen_shards) {  // NOLINT
+    parse("fsm1.json");
+    auto fsms = g.identify_fsms();
+    fsm::VerilogModule m(&g, p->parser_result());
+    m.set_fsm_result(fsms);
+    m.analyze_pins();
+    m.create_properties();
+
+    auto result = m.str();
+    auto temp_dir = fsm::fs::temp_directory_path();
+    auto filename = fsm::fs::join(temp_dir, "fsm_wrapper_test.sv");
+    auto filenames = m.to_files(filename, 2);
+    EXPECT_EQ(filenames.size(), 2);
+
+    // every property shows up in exactly one shard
+    std::string properties;
+    for (auto const &shard : filenames) {
+        std::ifstream stream(shard);
+        std::string content((std::istreambuf_iterator<char>(stream)),
+                            std::istreambuf_iterator<char>());
+        EXPECT_EQ(content.find("module TOP("), 0);
+        EXPECT_NE(content.find("endmodule"), std::string::npos);
+        auto start = content.find("property ");
+        if (start != std::string::npos) {
+            properties.append(content.substr(start, content.rfind("endmodule") - start));
+        }
+        fsm::fs::remove(shard);
+    }
+    auto start = result.find("property ");
+    EXPECT_EQ(properties, result.substr(start, result.rfind("endmodule") - start));
+}
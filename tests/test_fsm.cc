@@ -1,4 +1,9 @@
+#include <algorithm>
+#include <functional>
+#include <tuple>
+
 #include "../src/fsm.hh"
+#include "../src/synthetic.hh"
 #include "util.hh"
 
 TEST_F(GraphTest, fsm_extract_fsm1) {  // NOLINT
@@ -139,6 +144,9 @@ TEST_F(GraphTest, fsm_extract_fsm7) {  // NOLINT
 
     auto grouped_fsm = fsm::Graph::group_fsms(fsms);
     EXPECT_EQ(grouped_fsm.size(), 1);
+    // slow mode requires the coupling to go through a control node
+    auto grouped_slow = fsm::Graph::group_fsms(fsms, false);
+    EXPECT_EQ(grouped_slow.size(), 1);
 }
 
 TEST_F(GraphTest, fsm_extract_fsm8) {  // NOLINT
@@ -155,4 +163,223 @@ TEST_F(GraphTest, fsm_extract_fsm8) {  // NOLINT
     auto fsm = fsms[0];
     auto const &syntax_arc = fsm.syntax_arc();
     EXPECT_EQ(syntax_arc.size(), 4);
-}
\ No newline at end of file
+}
+
+TEST_F(GraphTest, slice) {  // NOLINT
+    parse("fsm2.json");
+    auto dut = g.select("dut");
+    EXPECT_NE(dut, nullptr);
+    auto sliced = g.slice(dut);
+    EXPECT_LT(sliced->nodes().size(), g.nodes().size());
+
+    auto sliced_dut = sliced->select("dut");
+    EXPECT_NE(sliced_dut, nullptr);
+    auto fsms = g.identify_fsms(dut);
+    auto sliced_fsms = sliced->identify_fsms(sliced_dut);
+    EXPECT_EQ(fsms.size(), sliced_fsms.size());
+    EXPECT_FALSE(sliced_fsms.empty());
+    for (uint64_t i = 0; i < fsms.size(); i++) {
+        auto const &fsm = fsms[i];
+        auto const &sliced_fsm = sliced_fsms[i];
+        // same hierarchical name
+        EXPECT_EQ(fsm.node()->handle_name(), sliced_fsm.node()->handle_name());
+        EXPECT_EQ(fsm.unique_states().size(), sliced_fsm.unique_states().size());
+    }
+}
+
+// FSM detection summary that doesn't depend on node identity
+std::pair<std::vector<std::tuple<std::string, bool, uint64_t, uint64_t>>, uint64_t> detect_fsms(
+    const std::string &filename, const std::function<void(fsm::Graph &)> &before_parse,
+    const std::function<void(fsm::Graph &)> &after_parse) {
+    fsm::Graph g;
+    before_parse(g);
+    fsm::Parser p(&g);
+    p.parse(filename);
+    after_parse(g);
+    auto fsms = g.identify_fsms();
+    fsm::merge_pipelined_fsm(fsms);
+    std::vector<std::tuple<std::string, bool, uint64_t, uint64_t>> result;
+    for (auto &fsm : fsms) {
+        fsm.extract_fsm_arcs();
+        result.emplace_back(fsm.node()->handle_name(), fsm.is_counter(),
+                            fsm.unique_states().size(), fsm.syntax_arc().size());
+    }
+    std::sort(result.begin(), result.end());
+    return std::make_pair(result, g.nodes().size());
+}
+
+const std::vector<std::string> fsm_vectors = {  // NOLINT
+    "fsm1.json", "fsm2.json", "fsm3.json", "fsm4.json", "fsm5.json",
+    "fsm6.json", "fsm7.json", "fsm8.json", "case.json"};
+
+TEST(FSM, constant_pool) {  // NOLINT
+    // FSM detection has to be the same with and without sharing constant nodes
+    auto no_op = [](fsm::Graph &) {};
+    for (auto const &filename : fsm_vectors) {
+        auto [pooled, pooled_size] = detect_fsms(filename, no_op, no_op);
+        auto [ref, ref_size] = detect_fsms(
+            filename, [](fsm::Graph &g) { g.set_constant_pool(false); }, no_op);
+        EXPECT_EQ(pooled, ref) << filename;
+        EXPECT_LE(pooled_size, ref_size) << filename;
+    }
+}
+
+TEST(FSM, unknown_state_values) {  // NOLINT
+    // state <= 4'b1x0z and state <= 4'b1000 are different states even though x/z read as 0
+    fsm::Graph g;
+    auto state = g.add_node(g.get_free_id(), "state", fsm::NodeType::Variable);
+    std::vector<fsm::Node *> constants;
+    for (auto const *str : {"4'b1x0z", "4'b1000", "4'b1x0z"}) {
+        auto literal = fsm::Literal::parse(str);
+        auto c = g.add_constant(literal.to_int64(), literal.width(),
+                                literal.fits_int64() ? nullptr : &literal);
+        auto assign = g.add_node(g.get_free_id(), "", fsm::NodeType::Assign);
+        c->add_edge(assign);
+        assign->add_edge(state, fsm::EdgeType::NonBlocking);
+        constants.emplace_back(c);
+    }
+    EXPECT_NE(constants[0], constants[1]);
+    EXPECT_EQ(constants[0], constants[2]);
+    EXPECT_EQ(constants[1]->value, constants[0]->value);
+    EXPECT_FALSE(constants[1]->value_key() == constants[0]->value_key());
+
+    fsm::FSMResult fsm(state, fsm::Graph::get_constant_source(state));
+    EXPECT_EQ(fsm.unique_states().size(), 2);
+}
+
+TEST(FSM, compact) {  // NOLINT
+    auto no_op = [](fsm::Graph &) {};
+    uint64_t nodes_removed = 0;
+    for (auto const &filename : fsm_vectors) {
+        auto [ref, ref_size] = detect_fsms(filename, no_op, no_op);
+        auto [compacted, compacted_size] =
+            detect_fsms(filename, no_op, [&nodes_removed](fsm::Graph &g) {
+                auto stats = g.compact();
+                EXPECT_EQ(stats.nodes_after, g.nodes().size());
+                EXPECT_EQ(stats.nodes_before - stats.nodes_after,
+                          stats.edges_before - stats.edges_after);
+                nodes_removed += stats.nodes_before - stats.nodes_after;
+            });
+        EXPECT_EQ(compacted, ref) << filename;
+        EXPECT_LE(compacted_size, ref_size) << filename;
+    }
+    EXPECT_GT(nodes_removed, 0);
+}
+
+TEST(FSM, compact_control_parent) {  // NOLINT
+    // if (in) if (net) ..., where net is an anonymous pass-through under the outer condition
+    fsm::Graph g;
+    auto in = g.add_node(g.get_free_id(), "in", fsm::NodeType::Variable);
+    auto outer = g.add_node(g.get_free_id(), "", fsm::NodeType::Control);
+    auto net = g.add_node(g.get_free_id(), "", fsm::NodeType::Net, outer);
+    auto inner = g.add_node(g.get_free_id(), "", fsm::NodeType::Control, outer);
+    in->add_edge(outer);
+    in->add_edge(net);
+    net->add_edge(inner);
+
+    auto stats = g.compact();
+    EXPECT_EQ(stats.nodes_after, stats.nodes_before - 1);
+    EXPECT_TRUE(net->edges_to.empty());
+    // removing the net doesn't give the condition a NodeInfo
+    EXPECT_FALSE(outer->has_info());
+}
+
+TEST(FSM, partition_edges) {  // NOLINT
+    // reordering the edges by class doesn't change FSM detection
+    auto no_op = [](fsm::Graph &) {};
+    for (auto const &filename : fsm_vectors) {
+        auto [ref, ref_size] = detect_fsms(filename, no_op, no_op);
+        auto [partitioned, partitioned_size] =
+            detect_fsms(filename, no_op, [](fsm::Graph &g) { g.partition_edges(); });
+        EXPECT_EQ(partitioned, ref) << filename;
+        EXPECT_EQ(partitioned_size, ref_size) << filename;
+    }
+}
+
+TEST(FSM, merge_pipelined) {  // NOLINT
+    // a -> b, c -> d and d -> b end up in the same pipeline even though a and c are merged
+    // separately at first
+    fsm::Graph g;
+    std::vector<fsm::Node *> nodes;
+    for (auto const *name : {"a", "e", "b", "c", "d"}) {
+        nodes.emplace_back(g.add_node(g.get_free_id(), name, fsm::NodeType::Variable));
+    }
+    auto pipeline = [&g](fsm::Node *from, fsm::Node *to) {
+        auto assign = g.add_node(g.get_free_id(), "", fsm::NodeType::Assign);
+        from->add_edge(assign);
+        assign->add_edge(to, fsm::EdgeType::NonBlocking);
+    };
+    pipeline(nodes[0], nodes[2]);
+    pipeline(nodes[3], nodes[4]);
+    pipeline(nodes[4], nodes[2]);
+
+    std::vector<fsm::FSMResult> fsms;
+    for (auto const *node : nodes) fsms.emplace_back(node, std::unordered_set<const fsm::Edge *>{});
+    fsm::merge_pipelined_fsm(fsms);
+    // the head of the pipeline is kept and the order doesn't change
+    EXPECT_EQ(fsms.size(), 2);
+    EXPECT_EQ(fsms[0].node(), nodes[0]);
+    EXPECT_EQ(fsms[1].node(), nodes[1]);
+}
+
+TEST_F(GraphTest, arc_extractor) {  // NOLINT
+    parse("fsm3.json");
+    auto fsms = g.identify_fsms();
+
+    // shared extraction gives the same arcs as extracting one by one
+    auto expected = fsms;
+    for (auto &fsm : expected) fsm.extract_fsm_arcs();
+    fsm::identify_fsm_arcs(fsms);
+    for (uint64_t i = 0; i < fsms.size(); i++) {
+        EXPECT_EQ(fsms[i].syntax_arc(), expected[i].syntax_arc());
+    }
+}
+
+TEST(FSM, synthetic) {  // NOLINT
+    fsm::SyntheticOptions options;
+    options.num_instances = 8;
+    options.fsms_per_module = 4;
+    options.states_per_fsm = 6;
+    options.counter_ratio = 0.25;
+    options.coupling_density = 0.25;
+    options.noise_registers = 4;
+    fsm::Graph g;
+    auto *top = fsm::generate_design(&g, options);
+    EXPECT_EQ(top->name, "top");
+
+    auto fsms = g.identify_fsms();
+    fsm::identify_fsm_arcs(fsms);
+    EXPECT_EQ(fsms.size(), options.num_instances * options.fsms_per_module);
+    uint64_t num_counters = 0;
+    for (auto const &fsm : fsms) {
+        EXPECT_TRUE(fsm.node()->child_of(top));
+        if (fsm.is_counter()) {
+            num_counters++;
+        } else {
+            // one arc per state, i.e. a ring
+            EXPECT_EQ(fsm.syntax_arc().size(), options.states_per_fsm);
+        }
+    }
+    EXPECT_EQ(num_counters, options.num_instances * options.counters_per_module());
+
+    // the same seed gives the same design, including which transitions are coupled
+    using EdgeList = std::vector<std::tuple<uint64_t, uint64_t, fsm::EdgeType>>;
+    auto edge_list = [](const fsm::Graph &graph) {
+        EdgeList result;
+        for (auto const &node : graph.nodes()) {
+            for (auto const &edge : node->edges_to) {
+                result.emplace_back(edge->from->id, edge->to->id, edge->type);
+            }
+        }
+        return result;
+    };
+    fsm::Graph g2;
+    fsm::generate_design(&g2, options);
+    EXPECT_EQ(g2.nodes().size(), g.nodes().size());
+    EXPECT_EQ(edge_list(g2), edge_list(g));
+
+    options.seed++;
+    fsm::Graph g3;
+    fsm::generate_design(&g3, options);
+    EXPECT_NE(edge_list(g3), edge_list(g));
+}
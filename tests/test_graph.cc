@@ -1,5 +1,6 @@
 #include <memory>
 
+#include "../src/synthetic.hh"
 #include "util.hh"
 
 using fsm::Graph;
@@ -154,4 +155,335 @@ TEST_F(GraphTest, counter) {   // NOLINT
         EXPECT_FALSE(values.empty());
         EXPECT_FALSE(Graph::is_counter(g_, values));
     }
-}
\ No newline at end of file
+}
+
+TEST(Graph, counter_assign_chain) {  // NOLINT
+    // continuous assigns reading the next state, i.e. assign x0 = state_next; assign x1 = x0; ...
+    // every one of them is an assignment is_counter has to look at
+    fsm::SyntheticOptions options;
+    options.fsms_per_module = 2;
+    options.counter_ratio = 0.5;
+    Graph g;
+    fsm::generate_design(&g, options);
+    for (auto const *name : {"inst0.counter0_next", "inst0.state1_next"}) {
+        auto prev = g.select(name);
+        ASSERT_NE(prev, nullptr);
+        for (auto i = 0; i < 16; i++) {
+            auto assign = g.add_node(g.get_free_id(), "", fsm::NodeType::Assign);
+            auto var = g.add_node(g.get_free_id(), "", fsm::NodeType::Variable);
+            prev->add_edge(assign);
+            assign->add_edge(var);
+            prev = var;
+        }
+    }
+    g.identify_registers();
+
+    auto counter = g.select("inst0.counter0");
+    auto values = Graph::get_constant_source(counter);
+    EXPECT_FALSE(values.empty());
+    EXPECT_TRUE(Graph::is_counter(counter, values));
+    auto state = g.select("inst0.state1");
+    values = Graph::get_constant_source(state);
+    EXPECT_FALSE(values.empty());
+    EXPECT_FALSE(Graph::is_counter(state, values));
+}
+
+TEST_F(GraphTest, identify_registers_incremental) {  // NOLINT
+    parse("fsm1.json");
+    g.identify_registers_incremental();
+    auto regs = g.get_registers();
+    EXPECT_EQ(regs.size(), 1);
+    auto reg = regs.front();
+
+    // a new non-blocking assignment to an existing variable
+    auto var = g.add_node(g.get_free_id(), "var", fsm::NodeType::Variable);
+    g.identify_registers_incremental();
+    EXPECT_EQ(g.get_registers().size(), 1);
+    auto assign = g.add_node(g.get_free_id(), "", fsm::NodeType::Assign);
+    reg->add_edge(assign, fsm::EdgeType::Blocking);
+    assign->add_edge(var, fsm::EdgeType::NonBlocking);
+    g.identify_registers_incremental();
+    EXPECT_EQ(g.get_registers().size(), 2);
+
+    // connecting existing nodes has to be marked explicitly
+    auto blocking = g.add_node(g.get_free_id(), "", fsm::NodeType::Assign);
+    g.identify_registers_incremental();
+    blocking->add_edge(var, fsm::EdgeType::Blocking);
+    g.touch_node(var);
+    g.identify_registers_incremental();
+    regs = g.get_registers();
+    EXPECT_EQ(regs.size(), 1);
+    EXPECT_EQ(regs.front(), reg);
+
+    // same as the full classification
+    g.identify_registers();
+    EXPECT_EQ(g.get_registers(), regs);
+}
+
+TEST(Graph, constant_driver_deep_chain) {  // NOLINT
+    // long next-state chains used to overflow the stack
+    constexpr uint64_t depth = 100000;
+    Graph g;
+    auto c = g.add_constant(1, 32);
+    auto var = g.add_node(g.get_free_id(), "var0", fsm::NodeType::Variable);
+    c->add_edge(g.add_node(g.get_free_id(), "", fsm::NodeType::Assign))->to->add_edge(var);
+    for (uint64_t i = 1; i < depth; i++) {
+        auto next = g.add_node(g.get_free_id(), "var" + std::to_string(i), fsm::NodeType::Variable);
+        auto assign = g.add_node(g.get_free_id(), "", fsm::NodeType::Assign);
+        var->add_edge(assign);
+        assign->add_edge(next);
+        var = next;
+    }
+
+    EXPECT_TRUE(Graph::constant_driver(var));
+    auto sources = Graph::get_constant_source(var);
+    EXPECT_EQ(sources.size(), 1);
+    EXPECT_EQ((*sources.begin())->from, c);
+
+    // a non-constant source at the bottom of the chain
+    auto in = g.add_node(g.get_free_id(), "in", fsm::NodeType::Net);
+    in->add_edge(c->edges_to.front()->to);
+    EXPECT_FALSE(Graph::constant_driver(var));
+    EXPECT_TRUE(Graph::get_constant_source(var).empty());
+}
+
+TEST(Graph, constant_pool_unknown) {  // NOLINT
+    Graph g;
+    auto zero = g.add_constant(0, 4);
+    auto unknown = fsm::Literal::parse("4'bxxxx");
+    auto x = g.add_constant(unknown.to_int64(), unknown.width(), &unknown);
+    EXPECT_NE(x, zero);
+    EXPECT_NE(x->wide_value, nullptr);
+    EXPECT_EQ(g.add_constant(unknown.to_int64(), unknown.width(), &unknown), x);
+    EXPECT_EQ(g.add_constant(0, 4), zero);
+    // a known literal shares the node with its plain value
+    auto known = fsm::Literal::parse("4'b0000");
+    EXPECT_EQ(g.add_constant(known.to_int64(), known.width(), &known), zero);
+    EXPECT_EQ(zero->wide_value, nullptr);
+}
+
+TEST(Graph, route_engine) {  // NOLINT
+    Graph g;
+    auto node = [&g](const std::string &name) {
+        return g.add_node(g.get_free_id(), name, fsm::NodeType::Variable);
+    };
+    auto a = node("a"), b = node("b"), n1 = node("n1"), n2 = node("n2");
+    a->add_edge(n1);
+    n1->add_edge(n2);
+    // the last edge doesn't have to satisfy the predicate
+    auto last = n2->add_edge(b, fsm::EdgeType::Control);
+    // longer detour
+    auto temp = a;
+    for (auto i = 0; i < 4; i++) {
+        auto next = node("d" + std::to_string(i));
+        temp->add_edge(next);
+        temp = next;
+    }
+    temp->add_edge(b);
+    // control edge in the middle blocks the route
+    auto c = node("c");
+    c->add_edge(n1, fsm::EdgeType::Control);
+
+    auto predicate = [](const fsm::Edge *edge) { return !edge->has_type(fsm::EdgeType::Control); };
+    fsm::RouteEngine engine(predicate);
+    auto path = engine.route(a, b);
+    EXPECT_EQ(path.size(), 3);
+    EXPECT_EQ(path.front()->from, a);
+    EXPECT_EQ(path.back(), last);
+    EXPECT_EQ(Graph::route(a, b, predicate).size(), path.size());
+    EXPECT_TRUE(engine.route(b, a).empty());
+    EXPECT_TRUE(engine.route(c, b).empty());
+
+    fsm::RouteEngine bounded(predicate, 2);
+    EXPECT_TRUE(bounded.route(a, b).empty());
+    EXPECT_EQ(bounded.route(n1, b).size(), 2);
+
+    auto paths = engine.route({{a, b}, {a, n2}, {b, a}, {n1, b}, {c, b}, {a, temp}});
+    EXPECT_EQ(paths[0], path);
+    EXPECT_EQ(paths[1].size(), 2);
+    EXPECT_TRUE(paths[2].empty());
+    EXPECT_EQ(paths[3].size(), 2);
+    EXPECT_TRUE(paths[4].empty());
+    EXPECT_EQ(paths[5].size(), 4);
+}
+
+TEST(Graph, reachability_engine) {  // NOLINT
+    // more than 64 registers, so that there are several batches
+    fsm::SyntheticOptions options;
+    options.num_instances = 24;
+    options.fsms_per_module = 4;
+    options.coupling_density = 0.5;
+    options.noise_registers = 2;
+    Graph g;
+    fsm::generate_design(&g, options);
+    g.identify_registers();
+    auto registers = g.get_registers();
+    std::vector<const fsm::Node *> nodes(registers.begin(), registers.end());
+    EXPECT_GT(nodes.size(), 128);
+
+    fsm::ReachabilityEngine engine;
+    auto reachable = engine.reachable(nodes, nodes);
+    std::vector<fsm::ReachabilityEngine::Query> queries;
+    uint64_t num_reachable = 0;
+    for (uint64_t i = 0; i < nodes.size(); i++) {
+        for (uint64_t j = 0; j < nodes.size(); j++) {
+            if (i == j) continue;
+            EXPECT_EQ(reachable[i][j], Graph::reachable(nodes[i], nodes[j]));
+            num_reachable += reachable[i][j];
+            queries.emplace_back(nodes[i], nodes[j]);
+        }
+    }
+    EXPECT_GT(num_reachable, 0);
+    EXPECT_LT(num_reachable, queries.size());
+
+    // same paths as the route engine
+    auto predicate = [](const fsm::Edge *edge) { return !edge->has_type(fsm::EdgeType::Control); };
+    for (auto max_length : {0u, 3u}) {
+        fsm::ReachabilityEngine bounded(predicate, max_length);
+        fsm::RouteEngine route(predicate, max_length);
+        auto result = bounded.reachable(queries);
+        auto paths = route.route(queries);
+        for (uint64_t i = 0; i < queries.size(); i++) {
+            EXPECT_EQ(result[i], !paths[i].empty());
+        }
+    }
+}
+
+TEST(Graph, traversal) {  // NOLINT
+    Graph g;
+    auto node = [&g](const std::string &name) {
+        return g.add_node(g.get_free_id(), name, fsm::NodeType::Variable);
+    };
+    auto a = node("a"), b = node("b"), c = node("c"), d = node("d");
+    a->add_edge(b);
+    a->add_edge(c, fsm::EdgeType::Control);
+    b->add_edge(d);
+    c->add_edge(d);
+    d->add_edge(a);
+
+    std::vector<const fsm::Node *> order;
+    auto record = [&order](const fsm::Edge *edge) {
+        order.emplace_back(edge->to);
+        return fsm::Step::Follow;
+    };
+    EXPECT_FALSE(fsm::breadth_first(a, record));
+    // every edge is visited, each node is expanded once
+    EXPECT_EQ(order, (std::vector<const fsm::Node *>{b, c, d, d, a}));
+    order.clear();
+    EXPECT_FALSE(fsm::breadth_first<fsm::edge_mask(fsm::EdgeType::Control)>(a, record));
+    EXPECT_EQ(order, (std::vector<const fsm::Node *>{b, d, a}));
+    EXPECT_TRUE(fsm::depth_first(a, [c](const fsm::Edge *edge) {
+        return edge->to == c ? fsm::Step::Stop : fsm::Step::Follow;
+    }));
+
+    // the std::function overloads give the same results as the template ones
+    auto data = [](const fsm::Edge *edge) { return !edge->has_type(fsm::EdgeType::Control); };
+    std::function<bool(const fsm::Edge *)> data_function = data;
+    EXPECT_TRUE(Graph::has_path(a, d, data));
+    EXPECT_FALSE(Graph::has_path(b, c, data));
+    EXPECT_FALSE(Graph::has_path(b, c, data_function));
+    auto to_d = [d](const fsm::Edge *edge) { return edge->to == d; };
+    auto edges = Graph::find_connection_cond(a, to_d);
+    EXPECT_EQ(edges.size(), 2);
+    EXPECT_EQ(Graph::find_connection_cond(a, std::function<bool(const fsm::Edge *)>(to_d)), edges);
+    EXPECT_EQ(Graph::find_connection_cond(a, to_d, data).size(), 1);
+    EXPECT_EQ(Graph::route(a, d, data), (std::vector<const fsm::Node *>{b, d}));
+    EXPECT_EQ(Graph::route(a, d, data_function), Graph::route(a, d, data));
+    EXPECT_TRUE(Graph::route(c, b, data, 1).empty());
+    EXPECT_EQ(Graph::route(c, b, data).size(), 3);
+
+    // control edges go last, the order within a class is kept
+    auto e = node("e");
+    auto slice = a->add_edge(e, fsm::EdgeType::Slice);
+    a->add_edge(d, fsm::EdgeType::True);
+    a->add_edge(e);
+    EXPECT_FALSE(a->edges_partitioned());
+    g.partition_edges();
+    EXPECT_TRUE(a->edges_partitioned());
+    EXPECT_EQ(a->slice_edges_begin, 2);
+    EXPECT_EQ(a->control_edges_begin, 3);
+    EXPECT_EQ(a->edges_to[0]->to, b);
+    EXPECT_EQ(a->edges_to[1]->to, e);
+    EXPECT_EQ(a->edges_to[2].get(), slice);
+    EXPECT_EQ(a->edges_to[3]->to, c);
+    EXPECT_EQ(a->edges_to[4]->to, d);
+    order.clear();
+    EXPECT_FALSE(fsm::breadth_first<fsm::edge_mask(fsm::EdgeType::Control)>(a, record));
+    EXPECT_EQ(order, (std::vector<const fsm::Node *>{b, e, e, d, a}));
+    uint64_t num_control = 0;
+    fsm::for_each_edge_to<fsm::ASSIGN_EDGES | fsm::SLICE_EDGES>(a, [&](const fsm::Edge *edge) {
+        EXPECT_TRUE(edge->has_type(fsm::EdgeType::Control));
+        num_control++;
+        return true;
+    });
+    EXPECT_EQ(num_control, 2);
+    // a new edge falls back to filtering
+    a->add_edge(c, fsm::EdgeType::Control);
+    EXPECT_FALSE(a->edges_partitioned());
+    EXPECT_EQ(Graph::find_sinks(a).size(), 4);
+}
+
+TEST_F(GraphTest, label_hierarchy) {  // NOLINT
+    parse("fsm3.json");
+    auto const &nodes = g.nodes();
+    std::vector<bool> expected;
+    for (auto const &a : nodes) {
+        for (auto const &b : nodes) expected.emplace_back(a->child_of(b.get()));
+    }
+
+    g.label_hierarchy();
+    uint64_t i = 0;
+    for (auto const &a : nodes) {
+        EXPECT_NE(a->hierarchy_pre, 0);
+        for (auto const &b : nodes) EXPECT_EQ(a->child_of(b.get()), expected[i++]);
+    }
+
+    // nodes added afterwards fall back to the parent chain
+    auto top = g.select("mod");
+    auto child = g.add_node(g.get_free_id(), "new", top);
+    EXPECT_TRUE(child->child_of(top));
+    EXPECT_FALSE(top->child_of(child));
+}
+
+TEST_F(GraphTest, stats) {  // NOLINT
+    parse("fsm3.json");
+    g.identify_registers();
+    auto stats = g.stats();
+    EXPECT_EQ(stats.num_nodes, g.nodes().size());
+    EXPECT_EQ(stats.num_edges, g.num_edges());
+
+    auto sum = [](auto const &values) {
+        uint64_t result = 0;
+        for (auto const &value : values) {
+            if constexpr (std::is_integral_v<std::decay_t<decltype(value)>>) {
+                result += value;
+            } else {
+                result += value.second;
+            }
+        }
+        return result;
+    };
+    EXPECT_EQ(sum(stats.node_types), stats.num_nodes);
+    EXPECT_EQ(sum(stats.edge_types), stats.num_edges);
+    EXPECT_EQ(sum(stats.fan_in), stats.num_nodes);
+    EXPECT_EQ(sum(stats.fan_out), stats.num_nodes);
+    EXPECT_GT(stats.node_types.count(fsm::NodeType::Register | fsm::NodeType::Variable), 0);
+    EXPECT_LT(stats.fan_out.size(), 65);
+    EXPECT_GE(stats.memory.nodes, stats.num_nodes * sizeof(fsm::Node));
+    EXPECT_GE(stats.memory.edges, stats.num_edges * sizeof(fsm::Edge));
+    EXPECT_GT(stats.memory.edges_from, 0);
+    EXPECT_GT(stats.memory.hash_tables, 0);
+    // conditions don't record the assignments under them
+    uint64_t num_controls = 0;
+    for (auto const &node : g.nodes()) {
+        if (!node->has_type(fsm::NodeType::Control)) continue;
+        num_controls++;
+        EXPECT_FALSE(node->has_info());
+    }
+    EXPECT_GT(num_controls, 0);
+
+    EXPECT_EQ(fsm::to_string(fsm::NodeType::Register | fsm::NodeType::Variable),
+              "Register|Variable");
+    EXPECT_EQ(fsm::to_string(fsm::EdgeType::False), "False");
+    EXPECT_EQ(fsm::to_string(fsm::EdgeType::NonBlocking), "NonBlocking");
+}
@@ -27,8 +27,8 @@ TEST_F(ParserTest, param) {  // NOLINT
     // param
     auto mod = g.select("mod");
     EXPECT_NE(mod, nullptr);
-    EXPECT_NE(mod->module_def, nullptr);
-    auto const &params = mod->module_def->params;
+    EXPECT_NE(mod->info().module_def, nullptr);
+    auto const &params = mod->info().module_def->params;
     EXPECT_EQ(params.size(), 2);
     EXPECT_TRUE(params.find("P") != params.end());
 
@@ -144,5 +144,98 @@ TEST_F(ParserTest, fsm1) {  // NOLINT
 
     // trigger type
     auto clk = g.select("clk");
-    EXPECT_EQ(clk->event_type, fsm::EventType::Posedge);
-}
\ No newline at end of file
+    EXPECT_EQ(clk->info().event_type, fsm::EventType::Posedge);
+}
+
+TEST(Literal, parse) {  // NOLINT
+    auto l = fsm::Literal::parse("3'b101");
+    EXPECT_EQ(l.width(), 3);
+    EXPECT_FALSE(l.is_signed());
+    EXPECT_EQ(l.to_int64(), 5);
+
+    l = fsm::Literal::parse("16'hDEAD_beef");
+    EXPECT_EQ(l.width(), 16);
+    EXPECT_EQ(l.to_int64(), 0xbeef);
+
+    l = fsm::Literal::parse("42");
+    EXPECT_EQ(l.width(), 32);
+    EXPECT_TRUE(l.is_signed());
+    EXPECT_FALSE(l.is_sized());
+    EXPECT_EQ(l.to_int64(), 42);
+    EXPECT_EQ(fsm::Literal::parse("-1").to_int64(), -1);
+    EXPECT_EQ(fsm::Literal::parse("4'sb1111").to_int64(), -1);
+    EXPECT_EQ(fsm::Literal::parse("'o17").to_int64(), 15);
+
+    l = fsm::Literal::parse("'1");
+    EXPECT_EQ(l.width(), 1);
+    EXPECT_EQ(l.to_int64(), 1);
+
+    l = fsm::Literal::parse("4'b1x0z");
+    EXPECT_TRUE(l.has_unknown());
+    EXPECT_EQ(l.to_int64(), 8);
+    EXPECT_EQ(l.unknown_word(0), 0b0101);
+    EXPECT_FALSE(l.fits_int64());
+    EXPECT_EQ(l.str(), "4'b1x0x");
+    auto known = fsm::Literal::parse("4'b1000");
+    EXPECT_FALSE(known.has_unknown());
+    EXPECT_NE(l, known);
+    EXPECT_NE(l.hash(), known.hash());
+    EXPECT_TRUE(known < l);
+    EXPECT_EQ(l, fsm::Literal::parse("4'b1z0x"));
+    // leftmost x/z digits are extended
+    EXPECT_EQ(fsm::Literal::parse("4'bx").unknown_word(0), 0b1111);
+    EXPECT_EQ(fsm::Literal::parse("8'h1x").unknown_word(0), 0x0f);
+    EXPECT_EQ(fsm::Literal::parse("'x").width(), 1);
+    EXPECT_EQ(fsm::Literal::parse("'x").unknown_word(0), 1);
+    EXPECT_EQ(fsm::Literal::parse("4'dx").unknown_word(0), 0b1111);
+    EXPECT_NE(fsm::Literal::parse("4'bxxxx"), fsm::Literal::parse("4'b0000"));
+    // bits truncated away don't count
+    EXPECT_FALSE(fsm::Literal::parse("2'bx01").has_unknown());
+
+    EXPECT_THROW(fsm::Literal::parse("'h"), std::runtime_error);
+    EXPECT_THROW(fsm::Literal::parse("0'd1"), std::runtime_error);
+}
+
+TEST(Literal, wide) {  // NOLINT
+    auto l = fsm::Literal::parse("128'h1_0000_0000_0000_0001");
+    EXPECT_EQ(l.width(), 128);
+    EXPECT_EQ(l.num_words(), 2);
+    EXPECT_EQ(l.word(0), 1);
+    EXPECT_EQ(l.word(1), 1);
+    EXPECT_FALSE(l.fits_int64());
+    EXPECT_EQ(l.str(), "128'h10000000000000001");
+
+    // decimal carries across words
+    EXPECT_EQ(fsm::Literal::parse("100'd18446744073709551617"), l);
+    EXPECT_TRUE(fsm::Literal::parse("128'h0000_0000_0000_0000_ffff") < l);
+    EXPECT_TRUE(fsm::Literal::parse("128'hffff").fits_int64());
+
+    // unsized numbers grow as needed
+    l = fsm::Literal::parse("'hffff_ffff_ffff_ffff_f");
+    EXPECT_EQ(l.width(), 68);
+    EXPECT_EQ(l.word(1), 0xf);
+
+    // negative numbers are truncated to the width
+    l = fsm::Literal::parse("-72'sd1");
+    EXPECT_EQ(l.word(0), 0xFFFFFFFFFFFFFFFF);
+    EXPECT_EQ(l.word(1), 0xFF);
+    EXPECT_TRUE(l.fits_int64());
+    EXPECT_EQ(l.to_int64(), -1);
+    EXPECT_EQ(fsm::Literal::parse("-72'sd1").hash(), l.hash());
+
+    l = fsm::Literal::parse("72'hx");
+    EXPECT_EQ(l.unknown_word(0), 0xFFFFFFFFFFFFFFFF);
+    EXPECT_EQ(l.unknown_word(1), 0xFF);
+    EXPECT_NE(l, fsm::Literal::parse("72'h0"));
+}
+
+#ifdef PASTAFARIAN_PARSER_STATS
+TEST_F(ParserTest, ast_kind_stats) {  // NOLINT
+    parse("hierarchy.json");
+    auto stats = fsm::Parser::ast_kind_stats();
+    std::unordered_map<std::string, uint64_t> counts(stats.begin(), stats.end());
+    EXPECT_GT(counts["ModuleInstance"], 0);
+    EXPECT_GT(counts["NamedValue"], 0);
+    EXPECT_EQ(counts.find("Unknown"), counts.end());
+}
+#endif
@@ -0,0 +1,179 @@
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "../src/stats.hh"
+#include "../src/util.hh"
+#include "gtest/gtest.h"
+
+using fsm::json::JSONWriter;
+
+TEST(JSONWriter, pretty) {  // NOLINT
+    JSONWriter w;
+    w.start_object();
+    w.write("name", std::string("a"));
+    w.start_array("states");
+    w.start_object().write("value", 1).write("name", std::string("IDLE")).end_object();
+    w.end_array();
+    w.start_array("linked").end_array();
+    w.start_object("info").write("counter", false).end_object();
+    w.end_object();
+
+    EXPECT_EQ(w.str(),
+              "{\n"
+              "  \"name\": \"a\",\n"
+              "  \"states\": [\n"
+              "    {\n"
+              "      \"value\": 1,\n"
+              "      \"name\": \"IDLE\"\n"
+              "    }\n"
+              "  ],\n"
+              "  \"linked\": [],\n"
+              "  \"info\": {\n"
+              "    \"counter\": false\n"
+              "  }\n"
+              "}");
+}
+
+TEST(JSONWriter, compact_escape) {  // NOLINT
+    JSONWriter w(false);
+    w.start_array();
+    w.write("a\"b\\c\nd\x01");
+    w.write(std::string_view("top.block[0].state"));
+    w.write(-42);
+    w.end_array();
+
+    EXPECT_EQ(w.str(), R"(["a\"b\\c\nd\u0001","top.block[0].state",-42])");
+}
+
+TEST(JSONWriter, stream) {  // NOLINT
+    std::stringstream stream;
+    {
+        JSONWriter w(stream, false);
+        w.start_array();
+        for (auto i = 0; i < 100000; i++) w.write(i);
+        w.end_array();
+    }
+    auto result = stream.str();
+    EXPECT_EQ(result.front(), '[');
+    EXPECT_EQ(result.back(), ']');
+    EXPECT_NE(result.find(",99999]"), std::string::npos);
+}
+
+TEST(string, split) {  // NOLINT
+    std::vector<std::string_view> tokens;
+    for (auto const &token : fsm::string::split("  94057640 mod  ", " ")) {
+        tokens.emplace_back(token);
+    }
+    EXPECT_EQ(tokens.size(), 2);
+    EXPECT_EQ(tokens[0], "94057640");
+    EXPECT_EQ(tokens[1], "mod");
+
+    auto range = fsm::string::split(";:", ";:");
+    EXPECT_EQ(range.begin(), range.end());
+
+    auto result = fsm::string::get_tokens("a.b..c", ".");
+    EXPECT_EQ(result, std::vector<std::string>({"a", "b", "c"}));
+}
+
+TEST(DisjointSet, merge) {  // NOLINT
+    fsm::DisjointSet sets(6);
+    EXPECT_TRUE(sets.merge(0, 1));
+    EXPECT_TRUE(sets.merge(2, 3));
+    EXPECT_FALSE(sets.merge(1, 0));
+    EXPECT_NE(sets.find(0), sets.find(2));
+    // both sides already have a different root
+    EXPECT_TRUE(sets.merge(1, 3));
+    EXPECT_EQ(sets.find(0), sets.find(2));
+    EXPECT_EQ(sets.find(3), sets.find(1));
+    EXPECT_NE(sets.find(4), sets.find(0));
+    EXPECT_NE(sets.find(4), sets.find(5));
+}
+
+TEST(Stats, phases) {  // NOLINT
+    auto &stats = fsm::Stats::instance();
+    {
+        // nothing is recorded when disabled
+        fsm::ScopedPhase phase("disabled");
+        stats.count("ignored", 1);
+    }
+    EXPECT_TRUE(stats.phases().empty());
+
+    stats.set_enabled(true);
+    {
+        fsm::ScopedPhase outer("outer");
+        stats.count("nodes", 2);
+        stats.count("nodes", 3);
+        {
+            fsm::ScopedPhase inner("inner");
+            stats.count("edges", 4);
+        }
+        fsm::ScopedPhase stopped("stopped");
+        stopped.stop();
+        stats.count("registers", 1);
+    }
+    stats.set_enabled(false);
+
+    auto phases = stats.phases();
+    ASSERT_EQ(phases.size(), 3);
+    EXPECT_EQ(phases[0].name, "outer");
+    EXPECT_EQ(phases[0].depth, 0);
+    using Counters = std::vector<std::pair<std::string, uint64_t>>;
+    EXPECT_EQ(phases[0].counters, (Counters{{"nodes", 5}, {"registers", 1}}));
+    EXPECT_EQ(phases[1].name, "outer/inner");
+    EXPECT_EQ(phases[1].depth, 1);
+    EXPECT_EQ(phases[1].counters, (Counters{{"edges", 4}}));
+    EXPECT_EQ(phases[2].name, "outer/stopped");
+    EXPECT_GE(phases[0].wall_time, phases[1].wall_time);
+    EXPECT_GT(phases[0].peak_rss, 0);
+
+    JSONWriter w(false);
+    stats.write(w);
+    auto str = w.str();
+    EXPECT_NE(str.find(R"("name":"outer/inner")"), std::string::npos);
+    EXPECT_NE(str.find(R"("counters":{"edges":4})"), std::string::npos);
+
+    stats.clear();
+    EXPECT_TRUE(stats.phases().empty());
+}
+
+TEST(Trace, threads) {  // NOLINT
+    auto &trace = fsm::Trace::instance();
+    trace.clear();
+    {
+        fsm::ScopedTrace event("disabled", "test");
+    }
+    EXPECT_EQ(trace.size(), 0);
+
+    trace.set_enabled(true);
+    {
+        fsm::ScopedPhase phase("phase");
+        std::vector<std::thread> threads;
+        for (uint32_t i = 0; i < 4; i++) {
+            threads.emplace_back([]() {
+                for (uint32_t j = 0; j < 100; j++) {
+                    fsm::ScopedTrace event("task", "test");
+                }
+            });
+        }
+        for (auto &t : threads) t.join();
+    }
+    trace.set_enabled(false);
+    EXPECT_EQ(trace.size(), 4 * 100 + 1);
+
+    JSONWriter w(false);
+    trace.write(w);
+    auto str = w.str();
+    EXPECT_NE(str.find(R"("name":"phase","cat":"phase","ph":"X")"), std::string::npos);
+    EXPECT_NE(str.find(R"("name":"task","cat":"test","ph":"X")"), std::string::npos);
+    // one metadata event per thread
+    uint64_t num_threads = 0;
+    for (auto pos = str.find("thread_name"); pos != std::string::npos;
+         pos = str.find("thread_name", pos + 1)) {
+        num_threads++;
+    }
+    EXPECT_EQ(num_threads, 5);
+
+    trace.clear();
+    EXPECT_EQ(trace.size(), 0);
+}
@@ -7,6 +7,7 @@
 #include "fsm.hh"
 #include "parser.hh"
 #include "source.hh"
+#include "stats.hh"
 #include "util.hh"
 
 std::vector<std::pair<const fsm::Property *, std::vector<const fsm::Property *>>> sort_fsm_result(
@@ -51,9 +52,9 @@ std::vector<std::pair<const fsm::Property *, std::vector<const fsm::Property *>>
 
 void print_fsm_value(const fsm::Node *node) {
     if (!node->name.empty()) {
-        std::cout << node->name << " (" << node->value << ")";
+        std::cout << node->name << " (" << node->value_str() << ")";
     } else {
-        std::cout << node->value;
+        std::cout << node->value_str();
     }
 }
 
@@ -153,11 +154,10 @@ void print_grouped_fsm(
     }
 }
 
-std::string output_json(
-    const std::vector<fsm::FSMResult> &fsms,
+void output_json(
+    fsm::json::JSONWriter &w, const std::vector<fsm::FSMResult> &fsms,
     const std::unordered_map<const fsm::Node *, std::unordered_set<const fsm::Node *>>
         &fsm_groups) {
-    fsm::json::JSONWriter w;
     w.start_array();
     for (auto const &fsm : fsms) {
         auto const node = fsm.node();
@@ -169,7 +169,12 @@ std::string output_json(
         for (auto const &state : fsm.const_src()) {
             w.start_object();
             auto state_node = state->from;
-            w.write("value", state_node->value).write("name", state_node->name);
+            if (state_node->wide_value) {
+                w.write("value", state_node->value_str());
+            } else {
+                w.write("value", state_node->value);
+            }
+            w.write("name", state_node->name);
             w.end_object();
         }
         w.end_array();
@@ -188,8 +193,7 @@ std::string output_json(
     }
 
     w.end_array();
-
-    return w.str();
+    w.flush();
 }
 
 std::unordered_map<std::string, int64_t> get_token_values(const std::vector<std::string> &values,
@@ -214,6 +218,90 @@ std::unordered_map<std::string, int64_t> get_token_values(const std::vector<std:
     return result;
 }
 
+void count_graph(const fsm::Graph &g) {
+    auto &stats = fsm::Stats::instance();
+    if (!stats.enabled()) return;
+    stats.count("nodes", g.nodes().size());
+    stats.count("edges", g.num_edges());
+}
+
+void output_stats(const std::string &filename, bool compact_json) {
+    if (filename.empty()) return;
+    if (filename == "-") {
+        fsm::json::JSONWriter w(std::cout, !compact_json);
+        fsm::Stats::instance().write(w);
+        std::cout << std::endl;
+    } else {
+        std::ofstream output(filename);
+        fsm::json::JSONWriter w(output, !compact_json);
+        fsm::Stats::instance().write(w);
+    }
+}
+
+void output_graph_stats(fsm::json::JSONWriter &w, const fsm::GraphStats &stats) {
+    w.start_object();
+    w.write("nodes", stats.num_nodes);
+    w.write("edges", stats.num_edges);
+    w.start_object("node_types");
+    for (auto const &[type, count] : stats.node_types) w.write(fsm::to_string(type), count);
+    w.end_object();
+    w.start_object("edge_types");
+    for (auto const &[type, count] : stats.edge_types) w.write(fsm::to_string(type), count);
+    w.end_object();
+    // histogram buckets are labelled with their upper bound
+    auto write_histogram = [&w](std::string_view name, const std::vector<uint64_t> &histogram) {
+        w.start_object(name);
+        for (uint64_t i = 0; i < histogram.size(); i++) {
+            if (histogram[i] == 0) continue;
+            w.write(i == 0 ? std::string("0") : fmt::format("<{0}", 1ull << i), histogram[i]);
+        }
+        w.end_object();
+    };
+    write_histogram("fan_in", stats.fan_in);
+    write_histogram("fan_out", stats.fan_out);
+    w.write("max_fan_in", stats.max_fan_in);
+    w.write("max_fan_out", stats.max_fan_out);
+
+    auto const &memory = stats.memory;
+    w.start_object("memory");
+    w.write("nodes", memory.nodes);
+    w.write("node_infos", memory.node_infos);
+    w.write("names", memory.names);
+    w.write("wire_types", memory.wire_types);
+    w.write("members", memory.members);
+    w.write("children", memory.children);
+    w.write("module_defs", memory.module_defs);
+    w.write("wide_values", memory.wide_values);
+    w.write("edges", memory.edges);
+    w.write("edges_from", memory.edges_from);
+    w.write("hash_tables", memory.hash_tables);
+    w.write("total", memory.total());
+    w.end_object();
+    w.end_object();
+    w.flush();
+}
+
+void output_graph_stats(const std::string &filename, const fsm::GraphStats &stats,
+                        bool compact_json) {
+    if (filename == "-") {
+        fsm::json::JSONWriter w(std::cout, !compact_json);
+        output_graph_stats(w, stats);
+        std::cout << std::endl;
+    } else {
+        std::ofstream output(filename);
+        fsm::json::JSONWriter w(output, !compact_json);
+        output_graph_stats(w, stats);
+    }
+}
+
+void output_trace(const std::string &filename) {
+    if (filename.empty()) return;
+    std::ofstream output(filename);
+    // traces get large, so no indentation
+    fsm::json::JSONWriter w(output, false);
+    fsm::Trace::instance().write(w);
+}
+
 void detect_slang(char *path) {
     auto detector_path = std::string(path);
     auto dir_name = fsm::fs::dirname(detector_path);
@@ -236,6 +324,8 @@ int main(int argc, char *argv[]) {
     std::vector<std::string> include_dirs;
     std::vector<std::string> filenames;
     std::string output_filename;
+    std::string stats_filename;
+    std::string trace_filename;
     bool compute_coupled_fsm = false;
     bool use_formal = false;
     std::string top;
@@ -246,6 +336,10 @@ int main(int argc, char *argv[]) {
     std::optional<uint32_t> num_cpu;
     bool double_edge_clk = false;
     bool merge_fsm = false;
+    bool compact_json = false;
+    bool compact_graph = false;
+    bool partition_edges = false;
+    std::string graph_stats_filename;
     std::optional<uint32_t> property_time_limit;
 
     fsm::ResetType reset_type = fsm::ResetType::Default;
@@ -258,6 +352,7 @@ int main(int argc, char *argv[]) {
     app.add_option("-i,--input", filenames, "SystemVerilog design files")->required();
     app.add_option("-I,--include", include_dirs, "SystemVerilog include search directory");
     app.add_option("--json", output_filename, "Output JSON. Use - for stdout");
+    app.add_flag("--compact-json", compact_json, "Output JSON without indentation");
     app.add_flag("-c,--coupled-fsm", compute_coupled_fsm, "Whether to compute coupled FSM");
     app.add_flag("--formal", use_formal, "Whether to use formal tools to determine FSM properties");
     app.add_option("--top", top, "Specify the design top");
@@ -272,20 +367,36 @@ int main(int argc, char *argv[]) {
                  "Set if the design had double-edge triggered clock");
     app.add_option("-t,--time-limit", property_time_limit, "Time limit per property");
     app.add_flag("-m,--merge", merge_fsm, "Set this flag to enable FSM merge");
+    app.add_flag("--compact-graph", compact_graph, "Remove pass-through nets after parsing");
+    app.add_flag("--partition-edges", partition_edges,
+                 "Group every node's edges by class so that traversals skip the ones they ignore");
+    app.add_option("--stats", stats_filename,
+                   "Output per-phase time, memory, and counters as JSON. Use - for stdout");
+    app.add_option("--graph-stats", graph_stats_filename,
+                   "Output node/edge counts and memory usage of the graph as JSON and exit. Use - "
+                   "for stdout");
+    app.add_option("--trace", trace_filename,
+                   "Output per-thread task events in the Chrome trace format");
 
     CLI11_PARSE(app, argc, argv)
 
     // automatic slang detection
     detect_slang(argv[0]);
 
+    if (!stats_filename.empty()) fsm::Stats::instance().set_enabled(true);
+    if (!trace_filename.empty()) fsm::Trace::instance().set_enabled(true);
+
     // multi-threading support
     if (num_cpu) {
         uint32_t cpu = *num_cpu;
         fsm::set_num_cpus(cpu);
     }
 
+    // keep stdout clean when it only carries the graph stats
+    auto &progress = graph_stats_filename == "-" ? std::cerr : std::cout;
+
     auto print_verilog_filenames = fsm::string::join(filenames.begin(), filenames.end(), " ");
-    std::cout << "Start parsing verilog file " << print_verilog_filenames << std::endl;
+    progress << "Start parsing verilog file " << print_verilog_filenames << std::endl;
 
     fsm::SourceManager manager;
     auto time_start = std::chrono::steady_clock::now();
@@ -296,21 +407,55 @@ int main(int argc, char *argv[]) {
         manager = fsm::SourceManager(filenames, include_dirs);
         auto macros = get_token_values(macro_values, true);
         manager.set_macros(macros);
+        fsm::ScopedPhase phase("slang");
         fsm::parse_verilog(manager);
     }
 
     // parse the design
-    std::cout << "Start parsing design..." << std::endl;
-    fsm::Graph g;
-    fsm::Parser p(&g);
+    progress << "Start parsing design..." << std::endl;
+    auto g = std::make_unique<fsm::Graph>();
+    fsm::Parser p(g.get());
+    fsm::ScopedPhase parse_phase("parse");
     p.parse(manager);
+    count_graph(*g);
+    parse_phase.stop();
 
     auto time_end = std::chrono::steady_clock::now();
     std::chrono::duration<float> time_used = time_end - time_start;
-    std::cout << "Parsing took " << time_used.count() << " seconds" << std::endl;
+    progress << "Parsing took " << time_used.count() << " seconds" << std::endl;
+
+    if (compact_graph) {
+        fsm::ScopedPhase phase("compact_graph");
+        auto stats = g->compact();
+        count_graph(*g);
+        progress << "Graph compaction: nodes " << stats.nodes_before << " -> " << stats.nodes_after
+                 << ", edges " << stats.edges_before << " -> " << stats.edges_after << std::endl;
+    }
+
+    if (!top.empty()) {
+        // only keep the design under test and its cone of influence
+        fsm::ScopedPhase phase("slice");
+        auto sliced = g->slice(fsm::find_top_module(*g, top));
+        count_graph(*sliced);
+        progress << "Graph slicing: nodes " << g->nodes().size() << " -> "
+                 << sliced->nodes().size() << std::endl;
+        g = std::move(sliced);
+    }
+
+    if (!graph_stats_filename.empty()) {
+        output_graph_stats(graph_stats_filename, g->stats(), compact_json);
+        output_stats(stats_filename, compact_json);
+        output_trace(trace_filename);
+        return EXIT_SUCCESS;
+    }
+
+    if (partition_edges) {
+        fsm::ScopedPhase phase("partition_edges");
+        g->partition_edges();
+    }
 
     // top module
-    fsm::VerilogModule m(&g, manager, top);
+    fsm::VerilogModule m(g.get(), manager, top);
 
     // assign reset types
     m.set_reset_type(reset_type);
@@ -321,7 +466,9 @@ int main(int argc, char *argv[]) {
     std::cout << "Detecting FSM..." << std::endl;
     time_start = std::chrono::steady_clock::now();
 
-    auto fsms = g.identify_fsms(m.top());
+    fsm::ScopedPhase identify_phase("identify_fsms");
+    auto fsms = g->identify_fsms(m.top());
+    identify_phase.stop();
 
     time_end = std::chrono::steady_clock::now();
     time_used = time_end - time_start;
@@ -332,10 +479,13 @@ int main(int argc, char *argv[]) {
     time_start = std::chrono::steady_clock::now();
 
     // extract syntax arc
+    fsm::ScopedPhase arcs_phase("extract_fsm_arcs");
     fsm::identify_fsm_arcs(fsms);
+    arcs_phase.stop();
     // merge fsm, if any
     auto raw_fsm_count = fsms.size();
     if (merge_fsm) {
+        fsm::ScopedPhase phase("merge_pipelined_fsm");
         fsm::merge_pipelined_fsm(fsms);
     }
 
@@ -348,8 +498,12 @@ int main(int argc, char *argv[]) {
     m.set_fsm_result(fsms);
     if (!clock_name.empty()) m.set_clock_name(clock_name);
     if (!reset_name.empty()) m.set_reset_name(reset_name);
+    fsm::ScopedPhase pins_phase("analyze_pins");
     m.analyze_pins();
+    pins_phase.stop();
+    fsm::ScopedPhase properties_phase("create_properties");
     m.create_properties();
+    properties_phase.stop();
 
     time_end = std::chrono::steady_clock::now();
     time_used = time_end - time_start;
@@ -362,6 +516,8 @@ int main(int argc, char *argv[]) {
 
     if (fsms.empty()) {
         std::cerr << "No FSM detected" << std::endl;
+        output_stats(stats_filename, compact_json);
+        output_trace(trace_filename);
         return EXIT_FAILURE;
     }
 
@@ -370,17 +526,24 @@ int main(int argc, char *argv[]) {
     if (compute_coupled_fsm) {
         std::cout << "Calculating coupled FSMs..." << std::endl;
         time_start = std::chrono::steady_clock::now();
+        fsm::ScopedPhase group_phase("group_fsms");
         fsm_groups = fsm::Graph::group_fsms(fsms);
+        uint64_t num_coupled = 0;
+        for (auto const &iter : fsm_groups) num_coupled += iter.second.size();
+        fsm::Stats::instance().count("coupled_fsms", num_coupled);
+        group_phase.stop();
         time_end = std::chrono::steady_clock::now();
         time_used = time_end - time_start;
         std::cout << "FSM coupling took " << time_used.count() << " seconds" << std::endl;
 
         // generate cross property coverage
+        fsm::ScopedPhase phase("cross_properties");
         m.add_cross_properties(fsm_groups);
     }
 
     // set properties
     if (use_formal) {
+        fsm::ScopedPhase phase("formal");
         fsm::JasperGoldGeneration jg(m);
         auto parameters = get_token_values(param_values);
         m.set_param_values(parameters);
@@ -411,12 +574,17 @@ int main(int argc, char *argv[]) {
     }
 
     if (!output_filename.empty()) {
-        auto str = output_json(fsms, fsm_groups);
         if (output_filename == "-") {
-            std::cout << str << std::endl;
+            fsm::json::JSONWriter w(std::cout, !compact_json);
+            output_json(w, fsms, fsm_groups);
+            std::cout << std::endl;
         } else {
             std::ofstream output(output_filename);
-            output << str;
+            fsm::json::JSONWriter w(output, !compact_json);
+            output_json(w, fsms, fsm_groups);
         }
     }
+
+    output_stats(stats_filename, compact_json);
+    output_trace(trace_filename);
 }